@@ -11,6 +11,8 @@
 # --all: compiles both the native code and the Scala code, in that order
 # --compile-dev: compiles the native code with debug symbols. The other two options,
 #                --native and --all, strip all debug symbols when compiling
+# --compile-test: like --compile-dev, but also counts native allocations, for
+#                 the tests that check the hot paths do not allocate
 
 # Make commands fail-fast
 set -e
@@ -23,7 +25,7 @@ LIBUAST_VERSION="3.4.3"
 UNZIP_DIR="sdk-${SDK_VERSION:1}"
 BBLFSH_PROTO="${PROTO_DIR}/github.com/bblfsh"
 SDK_PROTO="${BBLFSH_PROTO}/sdk/${SDK_MAJOR}"
-CPP_FLAGS="-shared -Wall -std=c++11"
+CPP_FLAGS="-shared -Wall -std=c++11 -pthread"
 DEBUG_FLAGS="-s -fPIC -O2"
 
 function setOSEnv {
@@ -121,7 +123,7 @@ function compileNativeCode {
 
     OUT_FOLDER=src/main/resources/lib/
     SRC_FOLDER="src/main/native"
-    SRC_FILES="${SRC_FOLDER}/org_bblfsh_client_v2_libuast_Libuast.cc ${SRC_FOLDER}/jni_utils.cc"
+    SRC_FILES="${SRC_FOLDER}/org_bblfsh_client_v2_libuast_Libuast.cc ${SRC_FOLDER}/jni_utils.cc ${SRC_FOLDER}/mapped_file.cc ${SRC_FOLDER}/uast_archive.cc ${SRC_FOLDER}/batch_filter.cc"
 
     mkdir -p ${OUT_FOLDER}
     ${COMPILER} ${FLAGS} ${DEBUG_FLAGS}\
@@ -148,7 +150,7 @@ setOSEnv
 # Parse arguments, execution depends on the order
 # we feed the arguments to the script
 function usage() {
-    echo "Usage: $0 [--clean|--get-dependencies|--native|--all|--compile-dev|--help]"
+    echo "Usage: $0 [--clean|--get-dependencies|--native|--all|--compile-dev|--compile-test|--help]"
     exit -3
 }
 
@@ -177,6 +179,11 @@ for arg in "$@"; do
             compileNativeCode && \
             compileScalaCode
             ;;
+        "--compile-test")
+            DEBUG_FLAGS="-g2 -O0 -DBBLFSH_COUNT_ALLOCS"
+            compileNativeCode && \
+            compileScalaCode
+            ;;
         "--help")
             usage
             ;;
@@ -0,0 +1,108 @@
+#include "batch_filter.h"
+
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "libuast.hpp"
+
+namespace {
+// Indices of the tasks of a single worker.
+// The owner takes them from the back, thieves from the front.
+class TaskQueue {
+ public:
+  void Push(size_t i) { tasks.push_back(i); }
+
+  bool Pop(size_t &i) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (tasks.empty()) return false;
+    i = tasks.back();
+    tasks.pop_back();
+    return true;
+  }
+
+  bool Steal(size_t &i) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (tasks.empty()) return false;
+    i = tasks.front();
+    tasks.pop_front();
+    return true;
+  }
+
+ private:
+  std::mutex mutex;
+  std::deque<size_t> tasks;
+};
+}  // namespace
+
+void ParallelFor(size_t n, unsigned threads,
+                 const std::function<void(size_t)> &fn) {
+  if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = (unsigned)std::min<size_t>(threads, n);
+  if (threads <= 1) {
+    for (size_t i = 0; i < n; i++) fn(i);
+    return;
+  }
+
+  // tasks are only added before the workers start, so a worker is done
+  // once it finds all the queues empty
+  std::vector<TaskQueue> queues(threads);
+  for (unsigned w = 0; w < threads; w++) {
+    size_t from = n * w / threads, to = n * (w + 1) / threads;
+    // reversed, so the owner runs its range in order
+    for (size_t i = to; i > from; i--) queues[w].Push(i - 1);
+  }
+
+  auto work = [&](unsigned w) {
+    size_t i;
+    for (;;) {
+      if (queues[w].Pop(i)) {
+        fn(i);
+        continue;
+      }
+      bool stolen = false;
+      for (unsigned k = 1; k < threads && !stolen; k++) {
+        stolen = queues[(w + k) % threads].Steal(i);
+      }
+      if (!stolen) return;
+      fn(i);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  workers.reserve(threads - 1);
+  for (unsigned w = 1; w < threads; w++) workers.emplace_back(work, w);
+  work(0);
+  for (auto &t : workers) t.join();
+}
+
+std::vector<int64_t> CountBatch(const std::vector<BatchBuffer> &buffers,
+                                const std::vector<std::string> &queries,
+                                UastFormat format, unsigned threads) {
+  const size_t nq = queries.size();
+  std::vector<int64_t> counts(buffers.size() * nq, 0);
+
+  ParallelFor(buffers.size(), threads, [&](size_t i) {
+    int64_t *out = &counts[i * nq];
+    try {
+      uast::Buffer ubuf(const_cast<char *>(buffers[i].data), buffers[i].size);
+      std::unique_ptr<uast::Context<NodeHandle>> ctx(
+          uast::Decode(ubuf, format));
+      NodeHandle root = ctx->RootNode();
+
+      for (size_t q = 0; q < nq; q++) {
+        std::unique_ptr<uast::Iterator<NodeHandle>> it(
+            ctx->Filter(root, queries[q]));
+        int64_t n = 0;
+        while (it && it->next()) n++;
+        out[q] = n;
+      }
+    } catch (const std::exception &) {
+      std::fill(out, out + nq, -1);
+    }
+  });
+  return counts;
+}
@@ -0,0 +1,37 @@
+#ifndef _Included_org_bblfsh_client_libuast_Libuast_batch_filter
+#define _Included_org_bblfsh_client_libuast_Libuast_batch_filter
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "libuast.h"
+
+// Runs fn(i) for every i in [0, n) on the given number of threads.
+//
+// Every thread starts with a contiguous range of the indices and, once it
+// runs out of them, steals from the other threads. The calling thread is
+// one of the workers. fn must not throw.
+void ParallelFor(size_t n, unsigned threads,
+                 const std::function<void(size_t)> &fn);
+
+// Encoded UAST, that must stay valid until the batch is done.
+struct BatchBuffer {
+  const char *data;
+  size_t size;
+};
+
+// Decodes every buffer and counts the results of every query in it, on the
+// given number of threads, or as many as the hardware supports if 0.
+//
+// Each context is decoded, queried and deleted by a single worker, and no
+// JNI calls are made, so the workers do not need to be attached to the JVM.
+// Returns the counts by buffer and then by query, with -1 for all the
+// queries of a buffer that failed to decode or to be queried.
+std::vector<int64_t> CountBatch(const std::vector<BatchBuffer> &buffers,
+                                const std::vector<std::string> &queries,
+                                UastFormat format, unsigned threads);
+
+#endif
@@ -1,25 +1,51 @@
 #include "jni_utils.h"
 
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
 // TODO(bzz): double-check and document. Suggestion and more context at
 // https://github.com/bblfsh/scala-client/pull/84#discussion_r288347756
 extern JavaVM *jvm;
 
+namespace {
+// JNIEnv of the current thread, looked up once per thread.
+//
+// Threads attached to the JVM by getJNIEnv() are detached when they exit,
+// which also frees the local references they created. Threads attached by
+// the JVM or by someone else are left as they are.
+struct ThreadEnv {
+  JNIEnv *env = nullptr;
+  bool attached = false;
+
+  ~ThreadEnv() {
+    if (attached && jvm) jvm->DetachCurrentThread();
+  }
+};
+
+thread_local ThreadEnv threadEnv;
+}  // namespace
+
 JNIEnv *getJNIEnv() {
-  JNIEnv *pEnv = NULL;
+  if (threadEnv.env) return threadEnv.env;
 
+  JNIEnv *pEnv = NULL;
   switch (jvm->GetEnv((void **)&pEnv, JNI_VERSION_1_8)) {
     case JNI_OK:  // Thread is ready to use, nothing to do
       break;
 
     case JNI_EDETACHED:  // Thread is detached, need to attach
-      jvm->AttachCurrentThread((void **)&pEnv, NULL);
-      // FIXME(bzz): this is a memory leak (at least)
-      //  - jvm->DetachCurrentThread() is never called
-      //  - local references are _never_ deleted :scream:
-      //    https://developer.android.com/training/articles/perf-jni#local-and-global-references
+      if (jvm->AttachCurrentThread((void **)&pEnv, NULL) != JNI_OK) {
+        return NULL;
+      }
+      threadEnv.attached = true;
       break;
+
+    default:
+      return NULL;
   }
 
+  threadEnv.env = pEnv;
   return pEnv;
 }
 
@@ -29,8 +55,13 @@ const char CLS_CTX_EXT[] = "org/bblfsh/client/v2/ContextExt";
 const char CLS_CTX[] = "org/bblfsh/client/v2/Context";
 const char CLS_TO[] = "org/bblfsh/client/v2/libuast/Libuast$TreeOrder";
 const char CLS_ENCS[] = "org/bblfsh/client/v2/libuast/Libuast$UastFormat";
-const char CLS_OBJ[] = "java/lang/Object";
+const char CLS_KINDS[] = "org/bblfsh/client/v2/libuast/Libuast$NodeKind";
+const char CLS_CURSOR[] = "org/bblfsh/client/v2/TreeCursor";
+const char CLS_ARCHIVE[] = "org/bblfsh/client/v2/UastArchive";
+const char CLS_SYSTEM[] = "java/lang/System";
 const char CLS_RE[] = "java/lang/RuntimeException";
+const char CLS_BYTE_BUF[] = "java/nio/ByteBuffer";
+const char CLS_LONG_ARR[] = "[J";
 const char CLS_JNODE[] = "org/bblfsh/client/v2/JNode";
 const char CLS_JNULL[] = "org/bblfsh/client/v2/JNull";
 const char CLS_JSTR[] = "org/bblfsh/client/v2/JString";
@@ -42,6 +73,8 @@ const char CLS_JARR[] = "org/bblfsh/client/v2/JArray";
 const char CLS_JOBJ[] = "org/bblfsh/client/v2/JObject";
 const char CLS_ITER[] = "org/bblfsh/client/v2/libuast/Libuast$UastIterExt";
 const char CLS_JITER[] = "org/bblfsh/client/v2/libuast/Libuast$UastIter";
+const char CLS_HANDLE_ITER[] =
+    "org/bblfsh/client/v2/libuast/Libuast$UastHandleIter";
 
 // Method signatures
 const char METHOD_JNODE_KEY_AT[] = "(I)Ljava/lang/String;";
@@ -62,50 +95,193 @@ const char METHOD_ITER_INIT[] = "(Lorg/bblfsh/client/v2/NodeExt;IJLorg/bblfsh/cl
 const char METHOD_JITER_INIT[] = "(Lorg/bblfsh/client/v2/JNode;IJLorg/bblfsh/client/v2/Context;)V";
 
 const char METHOD_NODE_INIT[] = "(Lorg/bblfsh/client/v2/ContextExt;J)V";
+const char METHOD_BYTE_BUF_ALLOC[] = "(I)Ljava/nio/ByteBuffer;";
 
 // Field signatures
 const char FIELD_ITER_NODE[] = "Ljava/lang/Object;";
 const char FIELD_CTX[] = "Lorg/bblfsh/client/v2/Context;";
 const char FIELD_CTX_EXT[] = "Lorg/bblfsh/client/v2/ContextExt;";
+const char FIELD_HANDLE_ITER_NODE[] = "Lorg/bblfsh/client/v2/NodeExt;";
 
+JavaIds ids;
 
-void clearClassCache(JNIEnv *env) {
-  for (auto cached : classCache) {
-    env->DeleteGlobalRef(cached.second);
-  }
+NativeStats stats;
+
+jobject NewGlobalRef(JNIEnv *env, jobject obj) {
+  jobject ref = env->NewGlobalRef(obj);
+  if (ref) stats.refsCreated++;
+  return ref;
 }
 
+void DeleteGlobalRef(JNIEnv *env, jobject ref) {
+  if (!ref) return;
+  env->DeleteGlobalRef(ref);
+  stats.refsDeleted++;
+}
 
-jclass FindClass(JNIEnv *env, const char *className) {
-  jclass result = classCache[className];
+jweak NewWeakGlobalRef(JNIEnv *env, jobject obj) {
+  jweak ref = env->NewWeakGlobalRef(obj);
+  if (ref) stats.refsCreated++;
+  return ref;
+}
 
-  if (!result) {
-    jclass localClassRef = env->FindClass(className);
+void DeleteWeakGlobalRef(JNIEnv *env, jweak ref) {
+  if (!ref) return;
+  env->DeleteWeakGlobalRef(ref);
+  stats.refsDeleted++;
+}
 
-    if (!localClassRef) {
-      checkJvmException(std::string("failed to find a class ").append(className));
-      return nullptr;
-    }
+namespace {
+// Resolves a class by its name, returns a global reference.
+jclass globalClass(JNIEnv *env, const char *name) {
+  jclass local = env->FindClass(name);
+  if (!local) return nullptr;
 
-    result = (jclass) env->NewGlobalRef(localClassRef);
-    classCache[className] = result;
-    env->DeleteLocalRef(localClassRef);
+  jclass global = (jclass)NewGlobalRef(env, local);
+  env->DeleteLocalRef(local);
+  return global;
+}
+}  // namespace
+
+// RESOLVE_* assign the id and bail out of ResolveIds() on failure,
+// leaving the pending NoClassDefFoundError/NoSuchMethodError for the JVM.
+#define RESOLVE_CLASS(id, name) \
+  if (!(ids.id = globalClass(env, name))) return false
+#define RESOLVE_METHOD(id, cls, name, sig) \
+  if (!(ids.id = env->GetMethodID(ids.cls, name, sig))) return false
+#define RESOLVE_STATIC_METHOD(id, cls, name, sig) \
+  if (!(ids.id = env->GetStaticMethodID(ids.cls, name, sig))) return false
+#define RESOLVE_FIELD(id, cls, name, sig) \
+  if (!(ids.id = env->GetFieldID(ids.cls, name, sig))) return false
+
+bool ResolveIds(JNIEnv *env) {
+  RESOLVE_CLASS(clsSystem, CLS_SYSTEM);
+  RESOLVE_CLASS(clsRE, CLS_RE);
+  RESOLVE_STATIC_METHOD(identityHash, clsSystem, "identityHashCode",
+                        "(Ljava/lang/Object;)I");
+  RESOLVE_METHOD(reInitCause, clsRE, "<init>", METHOD_RE_INIT_CAUSE);
+  RESOLVE_METHOD(reToString, clsRE, "toString", METHOD_OBJ_TO_STR);
+  RESOLVE_CLASS(clsByteBuf, CLS_BYTE_BUF);
+  RESOLVE_STATIC_METHOD(byteBufAllocDirect, clsByteBuf, "allocateDirect",
+                        METHOD_BYTE_BUF_ALLOC);
+  RESOLVE_CLASS(clsLongArr, CLS_LONG_ARR);
+
+  RESOLVE_CLASS(clsNode, CLS_NODE);
+  RESOLVE_CLASS(clsCtxExt, CLS_CTX_EXT);
+  RESOLVE_CLASS(clsCtx, CLS_CTX);
+  RESOLVE_METHOD(nodeInit, clsNode, "<init>", METHOD_NODE_INIT);
+  RESOLVE_METHOD(ctxExtInit, clsCtxExt, "<init>", "(J)V");
+  RESOLVE_METHOD(ctxInit, clsCtx, "<init>", "(J)V");
+  RESOLVE_FIELD(nodeCtx, clsNode, "ctx", FIELD_CTX_EXT);
+  RESOLVE_FIELD(nodeHandle, clsNode, "handle", "J");
+  RESOLVE_FIELD(ctxExtNative, clsCtxExt, "nativeContext", "J");
+  RESOLVE_FIELD(ctxNative, clsCtx, "nativeContext", "J");
+  RESOLVE_CLASS(clsCursor, CLS_CURSOR);
+  RESOLVE_FIELD(cursorNative, clsCursor, "nativeCursor", "J");
+
+  RESOLVE_CLASS(clsArchive, CLS_ARCHIVE);
+  RESOLVE_FIELD(archiveNative, clsArchive, "nativeArchive", "J");
+
+  RESOLVE_CLASS(clsIter, CLS_ITER);
+  RESOLVE_CLASS(clsJIter, CLS_JITER);
+  RESOLVE_CLASS(clsTreeOrder, CLS_TO);
+  RESOLVE_CLASS(clsUastFormat, CLS_ENCS);
+  RESOLVE_CLASS(clsNodeKind, CLS_KINDS);
+  RESOLVE_METHOD(iterInit, clsIter, "<init>", METHOD_ITER_INIT);
+  RESOLVE_METHOD(jiterInit, clsJIter, "<init>", METHOD_JITER_INIT);
+  RESOLVE_METHOD(treeOrderInit, clsTreeOrder, "<init>", "(IIIIII)V");
+  RESOLVE_METHOD(uastFormatInit, clsUastFormat, "<init>", "(II)V");
+  RESOLVE_METHOD(nodeKindInit, clsNodeKind, "<init>", "(IIIIIIII)V");
+  RESOLVE_FIELD(iterNode, clsIter, "node", FIELD_ITER_NODE);
+  RESOLVE_FIELD(iterOrder, clsIter, "treeOrder", "I");
+  RESOLVE_FIELD(iterPtr, clsIter, "iter", "J");
+  RESOLVE_FIELD(iterCtx, clsIter, "ctx", FIELD_CTX_EXT);
+  RESOLVE_FIELD(jiterNode, clsJIter, "node", FIELD_ITER_NODE);
+  RESOLVE_FIELD(jiterOrder, clsJIter, "treeOrder", "I");
+  RESOLVE_FIELD(jiterPtr, clsJIter, "iter", "J");
+  RESOLVE_FIELD(jiterCtx, clsJIter, "ctx", FIELD_CTX);
+  RESOLVE_CLASS(clsHandleIter, CLS_HANDLE_ITER);
+  RESOLVE_METHOD(handleIterInit, clsHandleIter, "<init>", METHOD_ITER_INIT);
+  RESOLVE_FIELD(handleIterNode, clsHandleIter, "node", FIELD_HANDLE_ITER_NODE);
+  RESOLVE_FIELD(handleIterOrder, clsHandleIter, "treeOrder", "I");
+  RESOLVE_FIELD(handleIterPtr, clsHandleIter, "iter", "J");
+  RESOLVE_FIELD(handleIterCtx, clsHandleIter, "ctx", FIELD_CTX_EXT);
+
+  RESOLVE_CLASS(clsJNode, CLS_JNODE);
+  RESOLVE_CLASS(clsJNull, CLS_JNULL);
+  RESOLVE_CLASS(clsJStr, CLS_JSTR);
+  RESOLVE_CLASS(clsJInt, CLS_JINT);
+  RESOLVE_CLASS(clsJFlt, CLS_JFLT);
+  RESOLVE_CLASS(clsJBool, CLS_JBOOL);
+  RESOLVE_CLASS(clsJUint, CLS_JUINT);
+  RESOLVE_CLASS(clsJArr, CLS_JARR);
+  RESOLVE_CLASS(clsJObj, CLS_JOBJ);
+  RESOLVE_METHOD(jnodeSize, clsJNode, "size", "()I");
+  RESOLVE_METHOD(jnodeKindTag, clsJNode, "kindTag", "()I");
+  RESOLVE_METHOD(jnodeKeyAt, clsJNode, "keyAt", METHOD_JNODE_KEY_AT);
+  RESOLVE_METHOD(jnodeValueAt, clsJNode, "valueAt", METHOD_JNODE_VALUE_AT);
+  RESOLVE_METHOD(jnullInit, clsJNull, "<init>", "()V");
+  RESOLVE_METHOD(jstrInit, clsJStr, "<init>", "(Ljava/lang/String;)V");
+  RESOLVE_METHOD(jstrStr, clsJStr, "str", "()Ljava/lang/String;");
+  RESOLVE_METHOD(jintInit, clsJInt, "<init>", "(J)V");
+  RESOLVE_METHOD(jintNum, clsJInt, "num", "()J");
+  RESOLVE_METHOD(jfltInit, clsJFlt, "<init>", "(D)V");
+  RESOLVE_METHOD(jfltNum, clsJFlt, "num", "()D");
+  RESOLVE_METHOD(jboolInit, clsJBool, "<init>", "(Z)V");
+  RESOLVE_METHOD(jboolValue, clsJBool, "value", "()Z");
+  RESOLVE_METHOD(juintInit, clsJUint, "<init>", "(J)V");
+  RESOLVE_METHOD(juintGet, clsJUint, "get", "()J");
+  RESOLVE_METHOD(jarrInit, clsJArr, "<init>", "(I)V");
+  RESOLVE_METHOD(jarrAdd, clsJArr, "add", METHOD_JARR_ADD);
+  RESOLVE_METHOD(jobjInit, clsJObj, "<init>", "()V");
+  RESOLVE_METHOD(jobjAdd, clsJObj, "add", METHOD_JOBJ_ADD);
+
+  return true;
+}
+
+#undef RESOLVE_CLASS
+#undef RESOLVE_METHOD
+#undef RESOLVE_STATIC_METHOD
+#undef RESOLVE_FIELD
+
+void ReleaseIds(JNIEnv *env) {
+  jclass *classes[] = {
+      &ids.clsSystem,     &ids.clsRE,   &ids.clsNode,  &ids.clsCtxExt,
+      &ids.clsCtx,        &ids.clsIter, &ids.clsJIter, &ids.clsTreeOrder,
+      &ids.clsUastFormat, &ids.clsJNode, &ids.clsJNull, &ids.clsJStr,
+      &ids.clsJInt,       &ids.clsJFlt, &ids.clsJBool, &ids.clsJUint,
+      &ids.clsJArr,       &ids.clsJObj, &ids.clsHandleIter,
+      &ids.clsCursor,     &ids.clsNodeKind, &ids.clsByteBuf,
+      &ids.clsLongArr,   &ids.clsArchive,
+  };
+  for (auto cls : classes) {
+    DeleteGlobalRef(env, *cls);
+    *cls = nullptr;
   }
+}
+
+void checkJvmException(JNIEnv *env, const std::string &msg) {
+  checkJvmException(env, msg.c_str());
+}
 
-  return result;
+void checkJvmException(JNIEnv *env, const char *prefix, const char *name) {
+  if (!env->ExceptionCheck()) return;
+  checkJvmException(env, std::string(prefix).append(name));
 }
 
+void checkJvmException(JNIEnv *env, const char *cmsg) {
+  // fast path, avoids a local ref and any message formatting
+  if (!env->ExceptionCheck()) return;
 
-void checkJvmException(std::string msg) {
-  JNIEnv *env = getJNIEnv();
   auto err = env->ExceptionOccurred();
   if (err) {
     env->ExceptionClear();
+    std::string msg(cmsg);
 
-    jstring s = (jstring)env->CallObjectMethod(err, exceptToString);
+    jstring s = (jstring)env->CallObjectMethod(err, ids.reToString);
     if (env->ExceptionCheck() || !s) {
       env->ExceptionClear();
-      env->ThrowNew(exceptionCls,
+      env->ThrowNew(ids.clsRE,
                     msg.append(" - failed co call method toString").data());
       return;
     }
@@ -115,22 +291,11 @@ void checkJvmException(std::string msg) {
     env->ReleaseStringUTFChars(s, utf);
 
     // new RuntimeException(jmsg, err)
-    jmethodID initId = MethodID(env, "<init>", METHOD_RE_INIT_CAUSE, CLS_RE);
-
-    if (env->ExceptionCheck() || !initId) {
-      env->ExceptionClear();
-      env->ThrowNew(exceptionCls,
-                    msg.append(" - failed to get method id for signature ")
-                        .append(METHOD_RE_INIT_CAUSE)
-                        .c_str());
-      return;
-    }
-
     jthrowable exception =
-        (jthrowable)env->NewObject(exceptionCls, initId, jmsg, err);
+        (jthrowable)env->NewObject(ids.clsRE, ids.reInitCause, jmsg, err);
     if (env->ExceptionCheck() || !exception) {
       env->ExceptionClear();
-      env->ThrowNew(exceptionCls,
+      env->ThrowNew(ids.clsRE,
                     msg.append(" - failed to create a new instance of ")
                         .append(CLS_RE)
                         .append(METHOD_RE_INIT_CAUSE)
@@ -142,147 +307,93 @@ void checkJvmException(std::string msg) {
   }
 }
 
-jobject NewJavaObject(JNIEnv *env, const char *className, const char *initSign,
-                      ...) {
-  // global ref
-  jclass cls = FindClass(env, className);
-  checkJvmException(std::string("failed to find a class ").append(className));
+bool ReadString(JNIEnv *env, jstring str, std::string &out) {
+  if (!str) {
+    out.clear();
+    return false;
+  }
 
-  jmethodID initId = MethodID(env, "<init>", initSign, className);
-  checkJvmException(std::string("failed to call a constructor with signature ")
-                        .append(initSign)
-                        .append(" for the class name ")
-                        .append(className));
+  jsize len = env->GetStringLength(str);
+  jsize size = env->GetStringUTFLength(str);
+  // GetStringUTFRegion writes a terminating zero past the last byte
+  out.resize(size + 1);
+  env->GetStringUTFRegion(str, 0, len, &out[0]);
+  out.resize(size);
+  return true;
+}
 
+const std::string &ScratchString(JNIEnv *env, jstring str) {
+  static thread_local std::string scratch;
+  ReadString(env, str, scratch);
+  return scratch;
+}
+
+#ifdef BBLFSH_COUNT_ALLOCS
+// Allocation counting for the native test build, see CONTRIBUTING.md.
+// Replaces the global operator new/delete of the library.
+static std::atomic<int64_t> allocations(0);
+
+void *operator new(size_t size) {
+  allocations++;
+  void *p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+
+int64_t NativeAllocations() { return allocations; }
+#else
+int64_t NativeAllocations() { return -1; }
+#endif
+
+jobject NewJavaObject(JNIEnv *env, jclass cls, jmethodID initId,
+                      const char *className, ...) {
   va_list varargs;
-  va_start(varargs, initSign);
+  va_start(varargs, className);
   jobject instance = env->NewObjectV(cls, initId, varargs);
   va_end(varargs);
-  checkJvmException(
-      std::string("failed get varargs for constructor of ").append(className));
+  checkJvmException(env, "failed to call a constructor of ", className);
 
   return instance;
 }
 
-jfieldID FieldID(JNIEnv *env, jobject obj, const char *field,
-                 const char *typeSignature) {
-  jclass cls = env->GetObjectClass(obj);
-  checkJvmException("failed get the class of an object");
-
-  // Note: printing the type from Scala to find the type needed for GetFieldID
-  // third argument using getClass.getName sometimes return objects different
-  // from the ones needed for the signature. To find the right type to use do
-  // this from Scala: (instance).getClass.getDeclaredField("fieldName")
-  jfieldID fId = env->GetFieldID(cls, field, typeSignature);
-  checkJvmException(std::string("failed get a field ID '")
-                        .append(field)
-                        .append("' for type signature '")
-                        .append(typeSignature)
-                        .append("'"));
-
-  env->DeleteLocalRef(cls);
-  return fId;
-}
-
-jobject ObjectField(JNIEnv *env, jobject obj, const char *name,
-                    const char *signature) {
-  jfieldID fId = FieldID(env, obj, name, signature);
-  if (!fId) {
-    checkJvmException(std::string("failed to get field ID for field name '")
-                          .append(name)
-                          .append("' with signature '")
-                          .append(signature)
-                          .append("'"));
-    return nullptr;
-  }
+jobject ObjectField(JNIEnv *env, jobject obj, jfieldID fId, const char *name) {
   jobject fld = env->GetObjectField(obj, fId);
-  checkJvmException(std::string("failed get an object from field '")
-                        .append(name)
-                        .append("'"));
+  checkJvmException(env, "failed get an object from field ", name);
   return fld;
 }
 
-jint IntField(JNIEnv *env, jobject obj, const char *name,
-              const char *signature) {
-  jfieldID fId = FieldID(env, obj, name, signature);
-  if (!fId) {
-    checkJvmException(std::string("failed to get field ID for field name '")
-                          .append(name)
-                          .append("' with signature '")
-                          .append(signature)
-                          .append("'"));
-    return -1;
-  }
+jint IntField(JNIEnv *env, jobject obj, jfieldID fId, const char *name) {
   jint fld = env->GetIntField(obj, fId);
-  checkJvmException(
-      std::string("failed get an Int from field '").append(name).append("'"));
+  checkJvmException(env, "failed get an Int from field ", name);
   return fld;
 }
 
-jmethodID MethodID(JNIEnv *env, const char *method, const char *signature,
-                   const char *className) {
-  jmethodID result = methodCache[className][method][signature];
-
-  if (!result) {
-    jclass cls = FindClass(env, className);
-    result = env->GetMethodID(cls, method, signature);
-
-    if (!result) {
-      checkJvmException(std::string("failed to get method ")
-                        .append(className)
-                        .append(".")
-                        .append(method));
-      return nullptr;
-    }
-
-    methodCache[className][method][signature] = result;
-  }
-
-  return result;
+jlong LongField(JNIEnv *env, jobject obj, jfieldID fId, const char *name) {
+  jlong fld = env->GetLongField(obj, fId);
+  checkJvmException(env, "failed get a Long from field ", name);
+  return fld;
 }
 
-jint IntMethod(JNIEnv *env, const char *method, const char *signature,
-               const char *className, const jobject object) {
-  jmethodID mId = MethodID(env, method, signature, className);
-  checkJvmException(std::string("failed to get method ")
-                        .append(className)
-                        .append(".")
-                        .append(method));
-
+jint IntMethod(JNIEnv *env, jmethodID mId, const char *method,
+               const jobject object) {
   jint res = env->CallIntMethod(object, mId);
-  checkJvmException(std::string("failed to call method ")
-                        .append(className)
-                        .append(".")
-                        .append(method)
-                        .append(" using signature ")
-                        .append(signature));
-
+  checkJvmException(env, "failed to call method ", method);
   return res;
 }
 
-jobject ObjectMethod(JNIEnv *env, const char *method, const char *signature,
-                     const char *className, const jobject object, ...) {
-  jmethodID mId = MethodID(env, method, signature, className);
-  checkJvmException(std::string("failed to get method ")
-                        .append(className)
-                        .append(".")
-                        .append(method));
-
+jobject ObjectMethod(JNIEnv *env, jmethodID mId, const char *method,
+                     const jobject object, ...) {
   va_list varargs;
   va_start(varargs, object);
   jobject res = env->CallObjectMethodV(object, mId, varargs);
   va_end(varargs);
-  checkJvmException(std::string("failed to get varargs for ")
-                        .append(className)
-                        .append(".")
-                        .append(method));
+  checkJvmException(env, "failed to call method ", method);
 
   return res;
 }
 
-void ThrowByName(JNIEnv *env, const char *className, const char *msg) {
-  jclass cls = FindClass(env, className);
-  if (cls) {
-    env->ThrowNew(cls, msg);
-  }
+void ThrowRuntime(JNIEnv *env, const char *msg) {
+  env->ThrowNew(ids.clsRE, msg);
 }
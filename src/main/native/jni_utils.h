@@ -2,21 +2,23 @@
 #define _Included_org_bblfsh_client_libuast_Libuast_jni_utils
 
 #include <jni.h>
+#include <atomic>
+#include <cstdint>
 #include <string>
-#include <unordered_map>
-
-template<class T>
-using Cache = std::unordered_map<std::string, T>;
 
 // Fully qualified Java class names
 extern const char CLS_NODE[];
 extern const char CLS_CTX_EXT[];
 extern const char CLS_CTX[];
-extern const char CLS_CTX[];
-extern const char CLS_OBJ[];
+extern const char CLS_SYSTEM[];
 extern const char CLS_RE[];
+extern const char CLS_BYTE_BUF[];
+extern const char CLS_LONG_ARR[];
 extern const char CLS_TO[];
 extern const char CLS_ENCS[];
+extern const char CLS_KINDS[];
+extern const char CLS_CURSOR[];
+extern const char CLS_ARCHIVE[];
 
 // Fully qualified class names for Bablefish UAST types
 extern const char CLS_JNODE[];
@@ -30,6 +32,7 @@ extern const char CLS_JARR[];
 extern const char CLS_JOBJ[];
 extern const char CLS_ITER[];
 extern const char CLS_JITER[];
+extern const char CLS_HANDLE_ITER[];
 
 // Method signatures
 extern const char METHOD_JNODE_KEY_AT[];
@@ -42,72 +45,211 @@ extern const char METHOD_RE_INIT_CAUSE[];
 extern const char METHOD_ITER_INIT[];
 extern const char METHOD_JITER_INIT[];
 extern const char METHOD_NODE_INIT[];
+extern const char METHOD_BYTE_BUF_ALLOC[];
 
 // Field signatures
 extern const char FIELD_ITER_NODE[];
 extern const char FIELD_CTX[];
 extern const char FIELD_CTX_EXT[];
+extern const char FIELD_HANDLE_ITER_NODE[];
 
-// Cached classes and method ids
-static Cache<jclass> classCache;
-static Cache<Cache<Cache<jmethodID> > > methodCache;
-static jclass exceptionCls;
-static jmethodID exceptToString;
-
-// Clears the cache of precomputed jclass references
-void clearClassCache(JNIEnv *env);
+// Preresolved classes, method and field IDs used by the native code.
+//
+// Filled once by ResolveIds() in JNI_OnLoad and released by ReleaseIds() in
+// JNI_OnUnload, so that hot paths never look anything up by name.
+// Classes are global references.
+struct JavaIds {
+  // java.lang
+  jclass clsSystem;
+  jclass clsRE;
+  jmethodID identityHash;  // static System.identityHashCode
+  jmethodID reInitCause;
+  jmethodID reToString;
+
+  // java.nio
+  jclass clsByteBuf;
+  jmethodID byteBufAllocDirect;  // static
+
+  // long[]
+  jclass clsLongArr;
+
+  // v2.NodeExt, v2.ContextExt, v2.Context
+  jclass clsNode;
+  jclass clsCtxExt;
+  jclass clsCtx;
+  jmethodID nodeInit;
+  jmethodID ctxExtInit;
+  jmethodID ctxInit;
+  jfieldID nodeCtx;
+  jfieldID nodeHandle;
+  jfieldID ctxExtNative;
+  jfieldID ctxNative;
+
+  // v2.TreeCursor
+  jclass clsCursor;
+  jfieldID cursorNative;
+
+  // v2.UastArchive
+  jclass clsArchive;
+  jfieldID archiveNative;
+
+  // v2.libuast.Libuast.{UastIterExt, UastIter, UastHandleIter, TreeOrder,
+  // UastFormat, NodeKind}
+  jclass clsIter;
+  jclass clsJIter;
+  jclass clsTreeOrder;
+  jclass clsUastFormat;
+  jclass clsNodeKind;
+  jmethodID iterInit;
+  jmethodID jiterInit;
+  jmethodID treeOrderInit;
+  jmethodID uastFormatInit;
+  jmethodID nodeKindInit;
+  jfieldID iterNode;
+  jfieldID iterOrder;
+  jfieldID iterPtr;
+  jfieldID iterCtx;
+  jfieldID jiterNode;
+  jfieldID jiterOrder;
+  jfieldID jiterPtr;
+  jfieldID jiterCtx;
+  jclass clsHandleIter;
+  jmethodID handleIterInit;
+  jfieldID handleIterNode;
+  jfieldID handleIterOrder;
+  jfieldID handleIterPtr;
+  jfieldID handleIterCtx;
+
+  // v2.JNode and its subclasses
+  jclass clsJNode;
+  jclass clsJNull;
+  jclass clsJStr;
+  jclass clsJInt;
+  jclass clsJFlt;
+  jclass clsJBool;
+  jclass clsJUint;
+  jclass clsJArr;
+  jclass clsJObj;
+  jmethodID jnodeSize;
+  jmethodID jnodeKindTag;
+  jmethodID jnodeKeyAt;
+  jmethodID jnodeValueAt;
+  jmethodID jnullInit;
+  jmethodID jstrInit;
+  jmethodID jstrStr;
+  jmethodID jintInit;
+  jmethodID jintNum;
+  jmethodID jfltInit;
+  jmethodID jfltNum;
+  jmethodID jboolInit;
+  jmethodID jboolValue;
+  jmethodID juintInit;
+  jmethodID juintGet;
+  jmethodID jarrInit;
+  jmethodID jarrAdd;
+  jmethodID jobjInit;
+  jmethodID jobjAdd;
+};
+
+extern JavaIds ids;
+
+// Counters of the native objects and memory held by the library.
+//
+// Always on and shared by all threads. Read by Libuast.stats() in the order
+// of the fields, keep both in sync.
+struct NativeStats {
+  std::atomic<int64_t> contextsExt;   // live ContextExt
+  std::atomic<int64_t> contexts;      // live Context
+  std::atomic<int64_t> iterators;     // native iterators held by JVM ones
+  std::atomic<int64_t> nodes;         // Node mirrors in Interface::obj2node
+  std::atomic<int64_t> refsCreated;   // global and weak global references
+  std::atomic<int64_t> refsDeleted;
+  std::atomic<int64_t> decodedBytes;  // encoded size of live ContextExt
+  std::atomic<int64_t> encodedBytes;  // encoded buffers being copied to the JVM
+};
+
+extern NativeStats stats;
+
+// Same as the JNIEnv methods, but counted in stats.
+jobject NewGlobalRef(JNIEnv *, jobject);
+void DeleteGlobalRef(JNIEnv *, jobject);
+jweak NewWeakGlobalRef(JNIEnv *, jobject);
+void DeleteWeakGlobalRef(JNIEnv *, jweak);
+
+// Resolves all the classes, methods and fields in ids.
+//
+// Must be called once from JNI_OnLoad. On failure returns false and leaves
+// the JVM exception pending.
+bool ResolveIds(JNIEnv *env);
 
-// Finds a class corresponding to the name 'className', null if it there is none
-// Returns a global reference
-jclass FindClass(JNIEnv *env, const char *className);
+// Deletes the global class references held in ids.
+void ReleaseIds(JNIEnv *env);
 
 // Checks through JNI, if there is a pending excption on the JVM side.
 //
 // Throws new RuntimeException to the JVM in case there is,
 // uses the original one as a cause and the given string as a message.
-void checkJvmException(std::string);
+// The message is only copied if there is an exception.
+void checkJvmException(JNIEnv *, const char *);
+void checkJvmException(JNIEnv *, const std::string &);
+
+// Same as checkJvmException, with a message made of the given prefix and
+// name, e.g. of a class, field or method. It is only built if there is an
+// exception.
+void checkJvmException(JNIEnv *, const char *, const char *);
 
 // Reads the JVM pointer of the current native thread.
 //
-// If the thread was not created by JVM - it will be attached to the JVM first.
-// Those threads need to be detached later on, in order to avoid memory leaks.
+// The pointer is cached per thread, so only the first call of a thread asks
+// the JVM for it. If the thread was not created by JVM - it will be attached
+// to the JVM first, and detached automatically when it exits.
+// Returns NULL if the thread cannot be attached.
+//
+// Functions that already have a JNIEnv should pass it down instead.
 JNIEnv *getJNIEnv();
 
-// Constructs new Java object of a given className and constructor signature.
-// Returns a local reference.
-jobject NewJavaObject(JNIEnv *, const char *, const char *, ...);
+// Copies a JVM string to out as modified UTF-8, reusing the capacity of out.
+// Returns false and leaves out empty if the string is null.
+bool ReadString(JNIEnv *, jstring, std::string &out);
 
-// Returns the field ID of the field of the given object.
-// The field is specified by its name and signature.
-jfieldID FieldID(JNIEnv *, jobject, const char *, const char *);
+// Copies a JVM string to a buffer of the current thread, that is reused
+// and overwritten by the next call on the same thread.
+// A null string is read as an empty one.
+const std::string &ScratchString(JNIEnv *, jstring);
+
+// Number of native allocations (operator new) made by the library, if it
+// was compiled with -DBBLFSH_COUNT_ALLOCS, or -1 otherwise.
+int64_t NativeAllocations();
+
+// Constructs new Java object of a given class using a constructor ID.
+// The class name is only used in the message of an exception.
+// Returns a local reference.
+jobject NewJavaObject(JNIEnv *, jclass, jmethodID, const char *, ...);
 
 // Reads the value of an Int field of a given object.
-// The field is specified by its name and signature.
-jint IntField(JNIEnv *, jobject, const char *, const char *);
+// The field name is only used in the message of an exception.
+jint IntField(JNIEnv *, jobject, jfieldID, const char *);
+
+// Reads the value of a Long field of a given object.
+// The field name is only used in the message of an exception.
+jlong LongField(JNIEnv *, jobject, jfieldID, const char *);
 
 // Reads the value of an Object field of a given object.
-// The field is specified by its name and signature.
+// The field name is only used in the message of an exception.
 // Returns a local reference.
-jobject ObjectField(JNIEnv *, jobject, const char *, const char *);
-
-// Returns the method ID for a method of a given class or interface name.
-// The method is determined by its name and signature.
-jmethodID MethodID(JNIEnv *, const char *, const char *, const char *);
+jobject ObjectField(JNIEnv *, jobject, jfieldID, const char *);
 
-// Calls a method of the given class or interface name that returns an Int.
-// The method is determined by its name and signature.
-jint IntMethod(JNIEnv *, const char *, const char *, const char *,
-               const jobject);
+// Calls a method that returns an Int on the given object.
+// The method name is only used in the message of an exception.
+jint IntMethod(JNIEnv *, jmethodID, const char *, const jobject);
 
-// Calls a method of the given class or interface name that returns an Object.
-// The method is determined by its name and signature.
+// Calls a method that returns an Object on the given object.
+// The method name is only used in the message of an exception.
 // Returns a local reference.
-jobject ObjectMethod(JNIEnv *, const char *, const char *, const char *,
-                     const jobject, ...);
+jobject ObjectMethod(JNIEnv *, jmethodID, const char *, const jobject, ...);
 
-// Constructs new object the given class name and throws it to JVM.
+// Constructs new RuntimeException with the given message and throws it to JVM.
 //
-// A fully qualified class name must name a valid Throwable type.
 // It does not interfere with the native control flow.
-void ThrowByName(JNIEnv *, const char *, const char *);
+void ThrowRuntime(JNIEnv *, const char *);
 #endif
@@ -0,0 +1,100 @@
+#include "mapped_file.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+std::runtime_error mappingError(const std::string &path, const char *what) {
+  return std::runtime_error(std::string("failed to map ")
+                                .append(path)
+                                .append(": ")
+                                .append(what));
+}
+}  // namespace
+
+#ifdef _WIN32
+std::shared_ptr<MappedFile> MappedFile::Open(const std::string &path) {
+  std::shared_ptr<MappedFile> f(new MappedFile(path));
+  f->mapping = nullptr;
+
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    throw mappingError(path, "cannot open the file");
+  }
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size)) {
+    CloseHandle(file);
+    throw mappingError(path, "cannot read the file size");
+  }
+  f->size = (size_t)size.QuadPart;
+  if (f->size == 0) {
+    CloseHandle(file);
+    return f;
+  }
+
+  // the view keeps the file open
+  f->mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (!f->mapping) {
+    throw mappingError(path, "cannot create the mapping");
+  }
+  f->data = (char *)MapViewOfFile(f->mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!f->data) {
+    throw mappingError(path, "cannot map the file");
+  }
+  return f;
+}
+
+MappedFile::~MappedFile() {
+  if (data) UnmapViewOfFile(data);
+  if (mapping) CloseHandle(mapping);
+}
+#else
+std::shared_ptr<MappedFile> MappedFile::Open(const std::string &path) {
+  std::shared_ptr<MappedFile> f(new MappedFile(path));
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw mappingError(path, strerror(errno));
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    int err = errno;
+    close(fd);
+    throw mappingError(path, strerror(err));
+  }
+  f->size = (size_t)st.st_size;
+  if (f->size == 0) {
+    close(fd);
+    return f;
+  }
+
+  // the mapping keeps the file open
+  void *p = mmap(nullptr, f->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  int err = errno;
+  close(fd);
+  if (p == MAP_FAILED) {
+    throw mappingError(path, strerror(err));
+  }
+  f->data = static_cast<char *>(p);
+  return f;
+}
+
+MappedFile::~MappedFile() {
+  if (data) munmap(data, size);
+}
+#endif
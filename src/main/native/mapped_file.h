@@ -0,0 +1,37 @@
+#ifndef _Included_org_bblfsh_client_libuast_Libuast_mapped_file
+#define _Included_org_bblfsh_client_libuast_Libuast_mapped_file
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// Read-only memory mapping of a whole file.
+//
+// Held through a shared pointer by everything decoded from it, so the
+// mapping is released together with the last of its users.
+class MappedFile {
+ public:
+  // Maps the file at the given path. Throws std::runtime_error on failure.
+  static std::shared_ptr<MappedFile> Open(const std::string &path);
+
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const char *Data() const { return data; }
+  size_t Size() const { return size; }
+  const std::string &Path() const { return path; }
+
+ private:
+  MappedFile(const std::string &p) : data(nullptr), size(0), path(p) {}
+
+  char *data;
+  size_t size;
+  std::string path;
+#ifdef _WIN32
+  void *mapping;
+#endif
+};
+
+#endif
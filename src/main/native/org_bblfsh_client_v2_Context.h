@@ -26,9 +26,9 @@ JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_Context_filter
 /*
  * Class:     org_bblfsh_client_v2_Context
  * Method:    nativeEncode
- * Signature: (Lorg/bblfsh/client/v2/JNode;I)Ljava/nio/ByteBuffer;
+ * Signature: (Lorg/bblfsh/client/v2/JNode;I)[B
  */
-JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_Context_nativeEncode
+JNIEXPORT jbyteArray JNICALL Java_org_bblfsh_client_v2_Context_nativeEncode
   (JNIEnv *, jobject, jobject, jint);
 
 /*
@@ -39,6 +39,22 @@ JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_Context_nativeEncode
 JNIEXPORT void JNICALL Java_org_bblfsh_client_v2_Context_dispose
   (JNIEnv *, jobject);
 
+/*
+ * Class:     org_bblfsh_client_v2_Context
+ * Method:    filterValues
+ * Signature: (Lorg/bblfsh/client/v2/JNode;Ljava/lang/String;I)Ljava/lang/Object;
+ */
+JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_Context_filterValues
+  (JNIEnv *, jobject, jobject, jstring, jint);
+
+/*
+ * Class:     org_bblfsh_client_v2_Context
+ * Method:    arenaBytes
+ * Signature: ()J
+ */
+JNIEXPORT jlong JNICALL Java_org_bblfsh_client_v2_Context_arenaBytes
+  (JNIEnv *, jobject);
+
 #ifdef __cplusplus
 }
 #endif
@@ -23,12 +23,20 @@ JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_ContextExt_root
 JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_ContextExt_filter
   (JNIEnv *, jobject, jstring);
 
+/*
+ * Class:     org_bblfsh_client_v2_ContextExt
+ * Method:    filterHandles
+ * Signature: (Ljava/lang/String;)Lorg/bblfsh/client/v2/libuast/Libuast/UastHandleIter;
+ */
+JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_ContextExt_filterHandles
+  (JNIEnv *, jobject, jstring);
+
 /*
  * Class:     org_bblfsh_client_v2_ContextExt
  * Method:    nativeEncode
- * Signature: (Lorg/bblfsh/client/v2/NodeExt;I)Ljava/nio/ByteBuffer;
+ * Signature: (Lorg/bblfsh/client/v2/NodeExt;I)[B
  */
-JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_ContextExt_nativeEncode
+JNIEXPORT jbyteArray JNICALL Java_org_bblfsh_client_v2_ContextExt_nativeEncode
   (JNIEnv *, jobject, jobject, jint);
 
 /*
@@ -39,6 +47,38 @@ JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_ContextExt_nativeEncode
 JNIEXPORT void JNICALL Java_org_bblfsh_client_v2_ContextExt_dispose
   (JNIEnv *, jobject);
 
+/*
+ * Class:     org_bblfsh_client_v2_ContextExt
+ * Method:    filterMany
+ * Signature: (Lorg/bblfsh/client/v2/NodeExt;[Ljava/lang/String;)[[J
+ */
+JNIEXPORT jobjectArray JNICALL Java_org_bblfsh_client_v2_ContextExt_filterMany
+  (JNIEnv *, jobject, jobject, jobjectArray);
+
+/*
+ * Class:     org_bblfsh_client_v2_ContextExt
+ * Method:    filterValues
+ * Signature: (Lorg/bblfsh/client/v2/NodeExt;Ljava/lang/String;I)Ljava/lang/Object;
+ */
+JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_ContextExt_filterValues
+  (JNIEnv *, jobject, jobject, jstring, jint);
+
+/*
+ * Class:     org_bblfsh_client_v2_ContextExt
+ * Method:    count
+ * Signature: (Ljava/lang/String;)J
+ */
+JNIEXPORT jlong JNICALL Java_org_bblfsh_client_v2_ContextExt_count
+  (JNIEnv *, jobject, jstring);
+
+/*
+ * Class:     org_bblfsh_client_v2_ContextExt
+ * Method:    exists
+ * Signature: (Ljava/lang/String;)Z
+ */
+JNIEXPORT jboolean JNICALL Java_org_bblfsh_client_v2_ContextExt_exists
+  (JNIEnv *, jobject, jstring);
+
 #ifdef __cplusplus
 }
 #endif
@@ -15,6 +15,22 @@ extern "C" {
 JNIEXPORT jlong JNICALL Java_org_bblfsh_client_v2_Context_00024_create
   (JNIEnv *, jobject);
 
+/*
+ * Class:     org_bblfsh_client_v2_Context__
+ * Method:    arenaPeakBytes
+ * Signature: ()J
+ */
+JNIEXPORT jlong JNICALL Java_org_bblfsh_client_v2_Context_00024_arenaPeakBytes
+  (JNIEnv *, jobject);
+
+/*
+ * Class:     org_bblfsh_client_v2_Context__
+ * Method:    arenaTotalBytes
+ * Signature: ()J
+ */
+JNIEXPORT jlong JNICALL Java_org_bblfsh_client_v2_Context_00024_arenaTotalBytes
+  (JNIEnv *, jobject);
+
 #ifdef __cplusplus
 }
 #endif
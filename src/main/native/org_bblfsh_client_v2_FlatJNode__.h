@@ -0,0 +1,21 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class org_bblfsh_client_v2_FlatJNode__ */
+
+#ifndef _Included_org_bblfsh_client_v2_FlatJNode__
+#define _Included_org_bblfsh_client_v2_FlatJNode__
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     org_bblfsh_client_v2_FlatJNode__
+ * Method:    encode
+ * Signature: (Ljava/nio/ByteBuffer;I)[B
+ */
+JNIEXPORT jbyteArray JNICALL Java_org_bblfsh_client_v2_FlatJNode_00024_encode
+  (JNIEnv *, jobject, jobject, jint);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -23,6 +23,14 @@ JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_NodeExt_load
 JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_NodeExt_filter
   (JNIEnv *, jobject, jstring);
 
+/*
+ * Class:     org_bblfsh_client_v2_NodeExt
+ * Method:    loadBuffer
+ * Signature: ()Ljava/nio/ByteBuffer;
+ */
+JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_NodeExt_loadBuffer
+  (JNIEnv *, jobject);
+
 #ifdef __cplusplus
 }
 #endif
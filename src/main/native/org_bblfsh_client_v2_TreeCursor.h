@@ -0,0 +1,117 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class org_bblfsh_client_v2_TreeCursor */
+
+#ifndef _Included_org_bblfsh_client_v2_TreeCursor
+#define _Included_org_bblfsh_client_v2_TreeCursor
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     org_bblfsh_client_v2_TreeCursor
+ * Method:    root
+ * Signature: ()J
+ */
+JNIEXPORT jlong JNICALL Java_org_bblfsh_client_v2_TreeCursor_root
+  (JNIEnv *, jobject);
+
+/*
+ * Class:     org_bblfsh_client_v2_TreeCursor
+ * Method:    kind
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_org_bblfsh_client_v2_TreeCursor_kind
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     org_bblfsh_client_v2_TreeCursor
+ * Method:    size
+ * Signature: (J)I
+ */
+JNIEXPORT jint JNICALL Java_org_bblfsh_client_v2_TreeCursor_size
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     org_bblfsh_client_v2_TreeCursor
+ * Method:    keyAt
+ * Signature: (JI)Ljava/lang/String;
+ */
+JNIEXPORT jstring JNICALL Java_org_bblfsh_client_v2_TreeCursor_keyAt
+  (JNIEnv *, jobject, jlong, jint);
+
+/*
+ * Class:     org_bblfsh_client_v2_TreeCursor
+ * Method:    valueAt
+ * Signature: (JI)J
+ */
+JNIEXPORT jlong JNICALL Java_org_bblfsh_client_v2_TreeCursor_valueAt
+  (JNIEnv *, jobject, jlong, jint);
+
+/*
+ * Class:     org_bblfsh_client_v2_TreeCursor
+ * Method:    get
+ * Signature: (JLjava/lang/String;)J
+ */
+JNIEXPORT jlong JNICALL Java_org_bblfsh_client_v2_TreeCursor_get
+  (JNIEnv *, jobject, jlong, jstring);
+
+/*
+ * Class:     org_bblfsh_client_v2_TreeCursor
+ * Method:    asInt
+ * Signature: (J)J
+ */
+JNIEXPORT jlong JNICALL Java_org_bblfsh_client_v2_TreeCursor_asInt
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     org_bblfsh_client_v2_TreeCursor
+ * Method:    asUint
+ * Signature: (J)J
+ */
+JNIEXPORT jlong JNICALL Java_org_bblfsh_client_v2_TreeCursor_asUint
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     org_bblfsh_client_v2_TreeCursor
+ * Method:    asFloat
+ * Signature: (J)D
+ */
+JNIEXPORT jdouble JNICALL Java_org_bblfsh_client_v2_TreeCursor_asFloat
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     org_bblfsh_client_v2_TreeCursor
+ * Method:    asBool
+ * Signature: (J)Z
+ */
+JNIEXPORT jboolean JNICALL Java_org_bblfsh_client_v2_TreeCursor_asBool
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     org_bblfsh_client_v2_TreeCursor
+ * Method:    asString
+ * Signature: (J)Ljava/lang/String;
+ */
+JNIEXPORT jstring JNICALL Java_org_bblfsh_client_v2_TreeCursor_asString
+  (JNIEnv *, jobject, jlong);
+
+/*
+ * Class:     org_bblfsh_client_v2_TreeCursor
+ * Method:    dispose
+ * Signature: ()V
+ */
+JNIEXPORT void JNICALL Java_org_bblfsh_client_v2_TreeCursor_dispose
+  (JNIEnv *, jobject);
+
+/*
+ * Class:     org_bblfsh_client_v2_TreeCursor
+ * Method:    filterNodes
+ * Signature: (Ljava/lang/String;)[J
+ */
+JNIEXPORT jlongArray JNICALL Java_org_bblfsh_client_v2_TreeCursor_filterNodes
+  (JNIEnv *, jobject, jstring);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
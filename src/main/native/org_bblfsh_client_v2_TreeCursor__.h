@@ -0,0 +1,29 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class org_bblfsh_client_v2_TreeCursor__ */
+
+#ifndef _Included_org_bblfsh_client_v2_TreeCursor__
+#define _Included_org_bblfsh_client_v2_TreeCursor__
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     org_bblfsh_client_v2_TreeCursor__
+ * Method:    create
+ * Signature: (Lorg/bblfsh/client/v2/NodeExt;)J
+ */
+JNIEXPORT jlong JNICALL Java_org_bblfsh_client_v2_TreeCursor_00024_create
+  (JNIEnv *, jobject, jobject);
+
+/*
+ * Class:     org_bblfsh_client_v2_TreeCursor__
+ * Method:    fromBuffer
+ * Signature: (Ljava/nio/ByteBuffer;)J
+ */
+JNIEXPORT jlong JNICALL Java_org_bblfsh_client_v2_TreeCursor_00024_fromBuffer
+  (JNIEnv *, jobject, jobject);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,61 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class org_bblfsh_client_v2_UastArchive */
+
+#ifndef _Included_org_bblfsh_client_v2_UastArchive
+#define _Included_org_bblfsh_client_v2_UastArchive
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     org_bblfsh_client_v2_UastArchive
+ * Method:    size
+ * Signature: ()I
+ */
+JNIEXPORT jint JNICALL Java_org_bblfsh_client_v2_UastArchive_size
+  (JNIEnv *, jobject);
+
+/*
+ * Class:     org_bblfsh_client_v2_UastArchive
+ * Method:    keyBytes
+ * Signature: (I)[B
+ */
+JNIEXPORT jbyteArray JNICALL Java_org_bblfsh_client_v2_UastArchive_keyBytes
+  (JNIEnv *, jobject, jint);
+
+/*
+ * Class:     org_bblfsh_client_v2_UastArchive
+ * Method:    containsKey
+ * Signature: ([B)Z
+ */
+JNIEXPORT jboolean JNICALL Java_org_bblfsh_client_v2_UastArchive_containsKey
+  (JNIEnv *, jobject, jbyteArray);
+
+/*
+ * Class:     org_bblfsh_client_v2_UastArchive
+ * Method:    metadataOf
+ * Signature: ([B)[B
+ */
+JNIEXPORT jbyteArray JNICALL Java_org_bblfsh_client_v2_UastArchive_metadataOf
+  (JNIEnv *, jobject, jbyteArray);
+
+/*
+ * Class:     org_bblfsh_client_v2_UastArchive
+ * Method:    decodeEntry
+ * Signature: ([BI)Lorg/bblfsh/client/v2/ContextExt;
+ */
+JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_UastArchive_decodeEntry
+  (JNIEnv *, jobject, jbyteArray, jint);
+
+/*
+ * Class:     org_bblfsh_client_v2_UastArchive
+ * Method:    dispose
+ * Signature: ()V
+ */
+JNIEXPORT void JNICALL Java_org_bblfsh_client_v2_UastArchive_dispose
+  (JNIEnv *, jobject);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
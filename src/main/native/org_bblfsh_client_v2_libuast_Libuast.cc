@@ -1,13 +1,35 @@
+#include <atomic>
 #include <cassert>
-
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "batch_filter.h"
 #include "jni_utils.h"
+#include "mapped_file.h"
 #include "org_bblfsh_client_v2_Context.h"
 #include "org_bblfsh_client_v2_ContextExt.h"
 #include "org_bblfsh_client_v2_Context__.h"
+#include "org_bblfsh_client_v2_FlatJNode__.h"
 #include "org_bblfsh_client_v2_NodeExt.h"
+#include "org_bblfsh_client_v2_TreeCursor.h"
+#include "org_bblfsh_client_v2_TreeCursor__.h"
+#include "org_bblfsh_client_v2_UastArchive.h"
+#include "org_bblfsh_client_v2_UastArchive__.h"
 #include "org_bblfsh_client_v2_libuast_Libuast.h"
+#include "org_bblfsh_client_v2_libuast_Libuast_UastHandleIter.h"
 #include "org_bblfsh_client_v2_libuast_Libuast_UastIter.h"
 #include "org_bblfsh_client_v2_libuast_Libuast_UastIterExt.h"
+#include "uast_archive.h"
 
 #include "libuast.h"
 #include "libuast.hpp"
@@ -17,70 +39,73 @@
 JavaVM *jvm;
 
 namespace {
-constexpr char nativeContext[] = "nativeContext";
-
-// Reads the opaque native pointer out of the field of the given object.
+// Reads the opaque native pointer out of the given object's field.
 //
-// The field is specified by its name and signature.
+// The field is specified by its preresolved ID.
 // Opaque pointer is casted to the given native type T.
 template <typename T>
-T *getHandle(JNIEnv *env, jobject obj, const char *name, const char *sig) {
-  jfieldID fId = FieldID(env, obj, name, sig);
-  if (!fId) return nullptr;
-
+T *getHandle(JNIEnv *env, jobject obj, jfieldID fId, const char *name) {
   jlong handle = env->GetLongField(obj, fId);
-  checkJvmException("failed to get long field " + std::string(name));
+  checkJvmException(env, "failed to get long field ", name);
   return reinterpret_cast<T *>(handle);
 }
 
-// Reads the opaque native pointer out of the given object's field.
-//
-// The field is specified by its name.
-// Opaque pointer is casted to the given native type T.
+// Same as getHandle, but throws to JVM if the object is null or its native
+// part was already disposed, e.g. by closing its NativeScope.
 template <typename T>
-T *getHandle(JNIEnv *env, jobject obj, const char *name) {
-  return getHandle<T>(env, obj, name, "J");
+T *liveHandle(JNIEnv *env, jobject obj, jfieldID fId, const char *cls) {
+  T *p = obj ? getHandle<T>(env, obj, fId, cls) : nullptr;
+  if (!p) {
+    ThrowRuntime(env, std::string(cls).append(" was already disposed").c_str());
+  }
+  return p;
 }
 
 template <typename T>
-void setHandle(JNIEnv *env, jobject obj, T *t, const char *name,
-               const char *sig) {
-  jfieldID fId = FieldID(env, obj, name, sig);
-  if (!fId) return;
-
+void setHandle(JNIEnv *env, jobject obj, T *t, jfieldID fId,
+               const char *name) {
   jlong handle = reinterpret_cast<jlong>(t);
   env->SetLongField(obj, fId, handle);
-  checkJvmException("failed to set handle for" + std::string(name));
-}
-
-template <typename T>
-void setHandle(JNIEnv *env, jobject obj, T *t, const char *name) {
-  setHandle<T>(env, obj, t, name, "J");
+  checkJvmException(env, "failed to set handle for ", name);
 }
 
-void setObjectField(JNIEnv *env, jobject obj, jobject field, const char *name, const char *sig) {
-  jfieldID fId = FieldID(env, obj, name, sig);
+void setObjectField(JNIEnv *env, jobject obj, jobject field, jfieldID fId,
+                    const char *name) {
   env->SetObjectField(obj, fId, field);
-  checkJvmException("failed to set object field for" + std::string(name));
+  checkJvmException(env, "failed to set object field for ", name);
 }
 
-jobject asJvmBuffer(uast::Buffer buf) {
+// Copies an encoded buffer to a new byte array and frees it, so the encoded
+// UAST is owned by the JVM and no native memory outlives the call.
+jbyteArray asJvmArray(uast::Buffer buf) {
   JNIEnv *env = getJNIEnv();
-  return env->NewDirectByteBuffer(buf.ptr, buf.size);
+  stats.encodedBytes += buf.size;
+  jbyteArray arr = nullptr;
+  if (buf.size > size_t(INT32_MAX)) {
+    ThrowRuntime(env, "encoded UAST is too large for a byte array");
+  } else {
+    arr = env->NewByteArray(jsize(buf.size));
+    if (arr) {
+      env->SetByteArrayRegion(arr, 0, jsize(buf.size),
+                              static_cast<const jbyte *>(buf.ptr));
+    }
+  }
+  // encoded buffers are allocated by libuast with malloc()
+  free(buf.ptr);
+  stats.encodedBytes -= buf.size;
+  return arr;
 }
 
 // Checks if a given object is of ContextExt class
 bool isContext(jobject obj, JNIEnv *env) {
   if (!obj) return false;
-  jclass ctxCls = FindClass(env, CLS_CTX_EXT);
-  return env->IsInstanceOf(obj, ctxCls);
+  return env->IsInstanceOf(obj, ids.clsCtxExt);
 }
 
 bool assertNotContext(jobject obj) {
   JNIEnv *env = getJNIEnv();
   if (isContext(obj, env)) {
-    auto reCls = FindClass(env, CLS_RE);
-    env->ThrowNew(reCls, "cannot use UAST Context as a Node");
+    ThrowRuntime(env, "cannot use UAST Context as a Node");
     return false;
   }
   return true;
@@ -94,12 +119,16 @@ class ContextExt {
  private:
   uast::Context<NodeHandle> *ctx;
   jobject jCtxExt;
+  // encoded UAST the context was decoded from, see newContextExt
+  std::shared_ptr<void> source;
+  // size of the encoded UAST, as an estimate of the memory held by ctx
+  size_t bytes;
 
   jobject toJ(NodeHandle node) {
     if (node == 0) return nullptr;
 
     JNIEnv *env = getJNIEnv();
-    jobject jObj = NewJavaObject(env, CLS_NODE, METHOD_NODE_INIT, jCtxExt, node);
+    jobject jObj = NewJavaObject(env, ids.clsNode, ids.nodeInit, "NodeExt", jCtxExt, node);
     return jObj;
   }
 
@@ -108,10 +137,8 @@ class ContextExt {
   NodeHandle toHandle(jobject obj) {
     if (!obj) return 0;
 
-    JNIEnv *env = getJNIEnv();  // TODO: refactor to JNI util LongField()
-    jclass cls = FindClass(env, CLS_NODE);
-
-    if (!env->IsInstanceOf(obj, cls)) {
+    JNIEnv *env = getJNIEnv();
+    if (!env->IsInstanceOf(obj, ids.clsNode)) {
       auto err = std::string("ContextExt.toHandle() argument is not")
                      .append(CLS_NODE)
                      .append(" type");
@@ -119,27 +146,32 @@ class ContextExt {
       return 0;
     }
 
-    jfieldID fId = FieldID(env, obj, "handle", "J");
-    if (!fId) {
-      return 0;
-    }
-
-    auto handle = (NodeHandle)env->GetLongField(obj, fId);
-    checkJvmException("failed to get field NodeExt.handle");
+    auto handle = (NodeHandle)env->GetLongField(obj, ids.nodeHandle);
+    checkJvmException(env, "failed to get field NodeExt.handle");
 
     return handle;
   }
 
  public:
   friend class Context;
-
-  ContextExt(uast::Context<NodeHandle> *c) : ctx(c) {}
+  friend class NativeTree;
+  friend class ScalarReader;
+
+  ContextExt(uast::Context<NodeHandle> *c, size_t size,
+             std::shared_ptr<void> src = nullptr)
+      : ctx(c), jCtxExt(nullptr), source(std::move(src)), bytes(size) {
+    stats.contextsExt++;
+    stats.decodedBytes += bytes;
+  }
 
   ~ContextExt() {
+    // the context goes before the mapping it may point to
     delete (ctx);
 
     if (jCtxExt)
-      getJNIEnv()->DeleteWeakGlobalRef(jCtxExt);
+      DeleteWeakGlobalRef(getJNIEnv(), jCtxExt);
+    stats.contextsExt--;
+    stats.decodedBytes -= bytes;
   }
 
   // lookup searches for a specific node handle.
@@ -154,7 +186,7 @@ class ContextExt {
   // We need this because a NodeExt from Scala side includes
   // a Scala ContextExt and a handle to the native C node
   void setManagedContext(jobject ctx) {
-    jCtxExt = getJNIEnv()->NewWeakGlobalRef(ctx);
+    jCtxExt = NewWeakGlobalRef(getJNIEnv(), ctx);
   }
 
   // Iterate returns iterator over an external UAST tree.
@@ -179,41 +211,309 @@ class ContextExt {
     return it;
   }
 
+  // Count returns the number of results of the query under the given node
+  // (or the root, if it is null), without creating any JVM objects.
+  // Borrows the reference.
+  int64_t Count(jobject node, const std::string &query) {
+    std::unique_ptr<uast::Iterator<NodeHandle>> it(Filter(node, query));
+    if (!it) return 0;
+
+    int64_t n = 0;
+    while (it->next()) n++;
+    return n;
+  }
+
+  // Exists checks if the query has any results under the given node
+  // (or the root, if it is null), stopping at the first one.
+  // Borrows the reference.
+  bool Exists(jobject node, const std::string &query) {
+    std::unique_ptr<uast::Iterator<NodeHandle>> it(Filter(node, query));
+    return it && it->next();
+  }
+
+  // FilterMany evaluates all the queries under the given node (or the root,
+  // if it is null) and returns the handles of the matches of each query.
+  // Borrows the reference.
+  std::vector<std::vector<jlong>> FilterMany(
+      jobject node, const std::vector<std::string> &queries) {
+    std::vector<std::vector<jlong>> results(queries.size());
+    if (!assertNotContext(node)) return results;
+
+    NodeHandle unode = toHandle(node);
+    if (unode == 0) unode = ctx->RootNode();
+
+    for (size_t i = 0; i < queries.size(); i++) {
+      std::unique_ptr<uast::Iterator<NodeHandle>> it(
+          ctx->Filter(unode, queries[i]));
+      if (!it) continue;
+      while (it->next()) {
+        NodeHandle h = it->node();
+        if (h == 0) break;
+        results[i].push_back(jlong(h));
+      }
+    }
+    return results;
+  }
+
   // Encode serializes the external UAST.
   // Borrows the reference.
-  jobject Encode(jobject node, UastFormat format) {
+  jbyteArray Encode(jobject node, UastFormat format) {
     if (!assertNotContext(node)) return nullptr;
 
     uast::Buffer data = ctx->Encode(toHandle(node), format);
-    return asJvmBuffer(data);
+    return asJvmArray(data);
   }
 };
 
-// creates new UastIterExt from the given context
-jobject filterUastIterExt(ContextExt *ctx, jobject jCtx, jstring jquery, JNIEnv *env) {
-  const char *q = env->GetStringUTFChars(jquery, 0);
-  std::string query = std::string(q);
-  env->ReleaseStringUTFChars(jquery, q);
-
+// creates new iterator of the given class (UastIterExt or UastHandleIter)
+// from the given context
+jobject filterIterExt(ContextExt *ctx, jobject jCtx, const std::string &query,
+                      jclass iterCls, jmethodID iterInit, JNIEnv *env) {
   auto node = ctx->RootNode();
   uast::Iterator<NodeHandle> *it = nullptr;
   try {
     it = ctx->Filter(node, query);
   } catch (const std::exception &e) {
-    ThrowByName(env, CLS_RE, e.what());
+    ThrowRuntime(env, e.what());
     return nullptr;
   }
 
-  // new UastIterExt()
-  jobject iter = NewJavaObject(env, CLS_ITER, METHOD_ITER_INIT, 0, 0, it, jCtx);
+  // new UastIterExt(null, 0, it, jCtx)
+  const char *iterName =
+      iterCls == ids.clsHandleIter ? "UastHandleIter" : "UastIterExt";
+  jobject iter = NewJavaObject(env, iterCls, iterInit, iterName,
+                               (jobject) nullptr, 0,
+                               reinterpret_cast<jlong>(it), jCtx);
 
   if (env->ExceptionCheck() || !iter) {
     delete (it);
-    checkJvmException("failed create new UastIterExt class");
+    checkJvmException(env, "failed create new iterator class");
+  } else if (it) {
+    stats.iterators++;
   }
   return iter;
 }
 
+// creates new iterator of the given class from the given context
+jobject filterIterExt(ContextExt *ctx, jobject jCtx, jstring jquery,
+                      jclass iterCls, jmethodID iterInit, JNIEnv *env) {
+  const std::string &query = ScratchString(env, jquery);
+
+  return filterIterExt(ctx, jCtx, query, iterCls, iterInit, env);
+}
+
+// creates new UastIterExt from the given context
+jobject filterUastIterExt(ContextExt *ctx, jobject jCtx, jstring jquery, JNIEnv *env) {
+  return filterIterExt(ctx, jCtx, jquery, ids.clsIter, ids.iterInit, env);
+}
+
+// Sets the iter and ctx fields of an iterator over an external UAST,
+// given its node: NodeExt and treeOrder fields.
+void initIterExt(JNIEnv *env, jobject self, jfieldID nodeFld,
+                 jfieldID orderFld, jfieldID iterFld, jfieldID ctxFld) {
+  jobject nodeExt = ObjectField(env, self, nodeFld, "node");
+  if (!nodeExt) {
+    return;
+  }
+
+  jobject jCtxExt = ObjectField(env, nodeExt, ids.nodeCtx, "NodeExt.ctx");
+  if (!jCtxExt)
+    return;
+
+  // borrow ContextExt from NodeExt
+  ContextExt *ctx =
+      liveHandle<ContextExt>(env, jCtxExt, ids.ctxExtNative, "ContextExt");
+  if (!ctx) return;
+
+  jint order = IntField(env, self, orderFld, "treeOrder");
+  if (order < 0) {
+    return;
+  }
+
+  auto it = ctx->Iterate(nodeExt, (TreeOrder)order);
+  if (it) stats.iterators++;
+
+  // this.iter = it;
+  setHandle<uast::Iterator<NodeHandle>>(env, self, it, iterFld, "iter");
+  // this.ctx = jCtxExt;
+  setObjectField(env, self, jCtxExt, ctxFld, "ctx");
+}
+
+// Releases the native iterator of an iterator over an external UAST.
+void disposeIterExt(JNIEnv *env, jobject self, jfieldID iterFld,
+                    jfieldID ctxFld) {
+  // this.ctx will be disposed by ContextExt finalizer
+  setObjectField(env, self, nullptr, ctxFld, "ctx");
+
+  // this.iter
+  auto iter = getHandle<uast::Iterator<NodeHandle>>(env, self, iterFld, "iter");
+  setHandle<uast::Iterator<NodeHandle>>(env, self, 0, iterFld, "iter");
+  if (iter) stats.iterators--;
+  delete (iter);
+}
+
+// ================================================
+// Arena allocation
+// ================================================
+
+// Bytes held by all the arenas, and the peak of that number.
+std::atomic<int64_t> arenaBytes(0);
+std::atomic<int64_t> arenaPeakBytes(0);
+
+// Arena is a bump allocator for small objects that live as long as it does.
+// Memory is allocated in blocks and released all at once, destructors of
+// the objects are not called.
+class Arena {
+ private:
+  static const size_t BlockSize = 64 * 1024;
+
+  std::vector<char *> blocks;
+  char *pos;
+  size_t left;
+  size_t bytes;
+
+  void grow(size_t size) {
+    size_t n = size > BlockSize ? size : BlockSize;
+    char *block = static_cast<char *>(malloc(n));
+    if (!block) throw std::bad_alloc();
+    blocks.push_back(block);
+    pos = block;
+    left = n;
+    bytes += n;
+
+    int64_t total = arenaBytes += n;
+    int64_t peak = arenaPeakBytes;
+    while (total > peak && !arenaPeakBytes.compare_exchange_weak(peak, total)) {
+    }
+  }
+
+ public:
+  Arena() : pos(nullptr), left(0), bytes(0) {}
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  ~Arena() {
+    for (auto block : blocks) free(block);
+    arenaBytes -= bytes;
+  }
+
+  // Alloc returns uninitialized memory with the given alignment.
+  void *Alloc(size_t size, size_t align) {
+    size_t pad = (align - reinterpret_cast<uintptr_t>(pos) % align) % align;
+    if (!pos || left < size + pad) {
+      grow(size + align);
+      pad = (align - reinterpret_cast<uintptr_t>(pos) % align) % align;
+    }
+    char *p = pos + pad;
+    pos += size + pad;
+    left -= size + pad;
+    return p;
+  }
+
+  // New constructs an object in the arena.
+  template <typename T, typename... Args>
+  T *New(Args &&... args) {
+    return new (Alloc(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  }
+
+  // CopyString copies the given characters to the arena.
+  const char *CopyString(const char *str, size_t len) {
+    char *p = static_cast<char *>(Alloc(len, 1));
+    memcpy(p, str, len);
+    return p;
+  }
+
+  // Bytes returns the size of all the blocks held by the arena.
+  size_t Bytes() { return bytes; }
+};
+
+// ================================================
+// Interned JVM strings
+// ================================================
+
+// StringTable interns the short strings that repeat in every tree as global
+// references to canonical JVM strings: object keys, and values like @type
+// and roles.
+//
+// Keys are interned on first sight. Values are only admitted after they were
+// seen AdmitCount times, so identifiers and literals that occur once or twice
+// don't fill the table; the counts are kept for a bounded number of
+// candidates and dropped when there are too many.
+//
+// The table is shared by all contexts and threads. It is split into shards
+// by hash, each with its own lock, so concurrent loads rarely wait for each
+// other. Each shard is bounded: once full, other strings are created as usual.
+class StringTable {
+ private:
+  static const size_t MaxLength = 64;
+  static const size_t Shards = 16;
+  static const size_t ShardCapacity = 1024;
+  static const size_t ShardCandidates = 4096;
+  static const uint32_t AdmitCount = 4;
+
+  struct Shard {
+    std::mutex mu;
+    std::unordered_map<std::string, jstring> strings;
+    std::unordered_map<std::string, uint32_t> seen;  // candidate values
+  };
+
+  Shard shards[Shards];
+
+  jstring get(JNIEnv *env, const std::string &str, bool admit, bool &local) {
+    local = false;
+    if (str.size() <= MaxLength) {
+      Shard &s = shards[std::hash<std::string>()(str) % Shards];
+      std::lock_guard<std::mutex> lock(s.mu);
+      auto it = s.strings.find(str);
+      if (it != s.strings.end()) return it->second;
+
+      if (!admit && s.strings.size() < ShardCapacity) {
+        if (s.seen.size() >= ShardCandidates) s.seen.clear();
+        auto seen = s.seen.emplace(str, 0).first;
+        admit = ++seen->second >= AdmitCount;
+        if (admit) s.seen.erase(seen);
+      }
+
+      if (admit && s.strings.size() < ShardCapacity) {
+        jstring jstr = env->NewStringUTF(str.c_str());
+        if (!jstr) return nullptr;
+        jstring global = (jstring)NewGlobalRef(env, jstr);
+        env->DeleteLocalRef(jstr);
+        s.strings.emplace(str, global);
+        return global;
+      }
+    }
+    local = true;
+    return env->NewStringUTF(str.c_str());
+  }
+
+ public:
+  // Key returns a JVM string for an object key. Sets local to true if
+  // the result is a new local reference, that the caller must delete,
+  // otherwise the reference is owned by the table.
+  jstring Key(JNIEnv *env, const std::string &str, bool &local) {
+    return get(env, str, true, local);
+  }
+
+  // Value is the same as Key, for a string value, that is only interned
+  // once it was seen a few times.
+  jstring Value(JNIEnv *env, const std::string &str, bool &local) {
+    return get(env, str, false, local);
+  }
+
+  // Clear deletes all the global references held by the table.
+  void Clear(JNIEnv *env) {
+    for (auto &s : shards) {
+      std::lock_guard<std::mutex> lock(s.mu);
+      for (auto &it : s.strings) DeleteGlobalRef(env, it.second);
+      s.strings.clear();
+      s.seen.clear();
+    }
+  }
+};
+
+StringTable jstrings;
+
 // ================================================
 // UAST Node interface (called from libuast)
 // ================================================
@@ -225,32 +525,34 @@ class Node : public uast::Node<Node *> {
   jobject obj;  // Node owns a (global) reference
   NodeKind kind;
 
-  std::string *str;
+  // cached value of a string node, owned by the arena of iface
+  const char *str;
+  size_t strLen;
 
-  // kindOf returns a kind of a JVM object.
+  // kindOf returns a kind of a JVM object, read from JNode.kindTag.
   // Borrows the reference.
-  static NodeKind kindOf(jobject obj) {
-    JNIEnv *env = getJNIEnv();
-    // TODO(bzz): expose JNode.kind & replace type comparison \w a string test
-    if (!obj || env->IsInstanceOf(obj, FindClass(env, CLS_JNULL))) {
-      return NODE_NULL;
-    } else if (env->IsInstanceOf(obj, FindClass(env, CLS_JSTR))) {
-      return NODE_STRING;
-    } else if (env->IsInstanceOf(obj, FindClass(env, CLS_JINT))) {
-      return NODE_INT;
-    } else if (env->IsInstanceOf(obj, FindClass(env, CLS_JFLT))) {
-      return NODE_FLOAT;
-    } else if (env->IsInstanceOf(obj, FindClass(env, CLS_JBOOL))) {
-      return NODE_BOOL;
-    } else if (env->IsInstanceOf(obj, FindClass(env, CLS_JUINT))) {
-      return NODE_UINT;
-    } else if (env->IsInstanceOf(obj, FindClass(env, CLS_JARR))) {
-      return NODE_ARRAY;
-    }
-    return NODE_OBJECT;
-  }
-
-  Node *lookupOrCreate(jobject obj);
+  static NodeKind kindOf(JNIEnv *env, jobject obj) {
+    // indexed by the JNode.*Tag constants
+    static const NodeKind kinds[] = {NODE_NULL,   NODE_OBJECT, NODE_ARRAY,
+                                     NODE_STRING, NODE_INT,    NODE_UINT,
+                                     NODE_FLOAT,  NODE_BOOL};
+    if (!obj) return NODE_NULL;
+
+    jint tag = env->CallIntMethod(obj, ids.jnodeKindTag);
+    checkJvmException(env, "failed to call JNode.kindTag at Node::kindOf()");
+    if (tag < 0 || tag >= (jint)(sizeof(kinds) / sizeof(kinds[0]))) {
+      return NODE_OBJECT;
+    }
+    return kinds[tag];
+  }
+
+  Node *lookupOrCreate(JNIEnv *env, jobject obj);
+
+  size_t size(JNIEnv *env) {
+    jint size = IntMethod(env, ids.jnodeSize, "JNode.size", obj);
+    assert(int32_t(size) >= 0);
+    return size;
+  }
 
  public:
   friend class Interface;
@@ -258,128 +560,75 @@ class Node : public uast::Node<Node *> {
 
   // Node creates a new node associated with a given JVM object and sets the
   // kind. Creates a new global reference.
-  Node(Interface *i, NodeKind k, jobject v) : str(nullptr) {
+  Node(JNIEnv *env, Interface *i, NodeKind k, jobject v)
+      : str(nullptr), strLen(0) {
     iface = i;
-    obj = getJNIEnv()->NewGlobalRef(v);
+    obj = NewGlobalRef(env, v);
     kind = k;
   }
 
   // Node creates a new node associated with a given JVM object and
   // automatically determines the kind. Creates a new global reference.
-  Node(Interface *i, jobject v) : str(nullptr) {
+  Node(JNIEnv *env, Interface *i, jobject v) : str(nullptr), strLen(0) {
     iface = i;
-    obj = getJNIEnv()->NewGlobalRef(v);
-    kind = kindOf(v);
+    obj = NewGlobalRef(env, v);
+    kind = kindOf(env, v);
   }
 
   ~Node() {
     JNIEnv *env = getJNIEnv();
-    if (obj) {
-      env->DeleteGlobalRef(obj);
-    }
-    if (str) {
-      delete str;
-    }
+    DeleteGlobalRef(env, obj);
   }
 
   jobject toJ();
 
   NodeKind Kind() { return kind; }
 
-  std::string *AsString() {  // new ref
-    if (!str) {
-      const char methodName[] = "str";
-      JNIEnv *env = getJNIEnv();
-      jstring jstr = (jstring)ObjectMethod(
-          env, methodName, "()Ljava/lang/String;", CLS_JSTR, obj);
-
-      const char *utf = env->GetStringUTFChars(jstr, 0);
-      str = new std::string(utf);
-      env->ReleaseStringUTFChars(jstr, utf);
-      env->DeleteLocalRef(jstr);
-    }
-
-    std::string *s = new std::string(*str);
-    return s;
-  }
+  std::string *AsString();  // new ref
   int64_t AsInt() {
-    const char methodName[] = "num";
     JNIEnv *env = getJNIEnv();
-    jmethodID mID = MethodID(env, methodName, "()J", CLS_JINT);
-
-    long long value = (long long)env->CallLongMethod(obj, mID);
-    checkJvmException(std::string("failed to call ")
-                          .append(CLS_JINT)
-                          .append(".")
-                          .append(methodName)
-                          .append(" at Node::AsInt()"));
+    long long value = (long long)env->CallLongMethod(obj, ids.jintNum);
+    checkJvmException(env, "failed to call JInt.num at Node::AsInt()");
     return (int64_t)(value);
   }
   uint64_t AsUint() {
-    const char methodName[] = "get";
     JNIEnv *env = getJNIEnv();
-    jmethodID mID = MethodID(env, methodName, "()J", CLS_JUINT);
-
-    jlong value = env->CallLongMethod(obj, mID);
-    checkJvmException(std::string("failed to call ")
-                          .append(CLS_JUINT)
-                          .append(".")
-                          .append(methodName)
-                          .append(" at Node::AsUint()"));
+    jlong value = env->CallLongMethod(obj, ids.juintGet);
+    checkJvmException(env, "failed to call JUint.get at Node::AsUint()");
     return (uint64_t)(value);
   }
   double AsFloat() {
-    const char methodName[] = "num";
     JNIEnv *env = getJNIEnv();
-    jmethodID mID = MethodID(env, methodName, "()D", CLS_JFLT);
-
-    double value = (double)env->CallDoubleMethod(obj, mID);
-    checkJvmException(std::string("failed to call ")
-                          .append(CLS_JFLT)
-                          .append(".")
-                          .append(methodName)
-                          .append(" at Node::AsFloat()"));
+    double value = (double)env->CallDoubleMethod(obj, ids.jfltNum);
+    checkJvmException(env, "failed to call JFloat.num at Node::AsFloat()");
     return value;
   }
   bool AsBool() {
-    const char methodName[] = "value";
     JNIEnv *env = getJNIEnv();
-    jmethodID mID = MethodID(env, methodName, "()Z", CLS_JBOOL);
-
-    bool value = (bool)env->CallBooleanMethod(obj, mID);
-    checkJvmException(std::string("failed to call ")
-                          .append(CLS_JBOOL)
-                          .append(".")
-                          .append(methodName)
-                          .append(" at Node::AsBool()"));
+    bool value = (bool)env->CallBooleanMethod(obj, ids.jboolValue);
+    checkJvmException(env, "failed to call JBool.value at Node::AsBool()");
     return value;
   }
-  size_t Size() {
-    jint size = IntMethod(getJNIEnv(), "size", "()I", CLS_JNODE, obj);
-    assert(int32_t(size) >= 0);
-    return size;
-  }
+  size_t Size() { return size(getJNIEnv()); }
   std::string *KeyAt(size_t i) {
-    if (!obj || i >= Size()) return nullptr;
-
     JNIEnv *env = getJNIEnv();
-    jstring key = (jstring)ObjectMethod(env, "keyAt", METHOD_JNODE_KEY_AT,
-                                        CLS_JNODE, obj, i);
+    if (!obj || i >= size(env)) return nullptr;
+
+    jstring key = (jstring)ObjectMethod(env, ids.jnodeKeyAt, "JNode.keyAt", obj, i);
 
-    const char *k = env->GetStringUTFChars(key, 0);
-    std::string *s = new std::string(k);
-    env->ReleaseStringUTFChars(key, k);
+    // the only copy is the one returned to libuast
+    std::string *s = new std::string();
+    ReadString(env, key, *s);
     env->DeleteLocalRef(key);
     return s;
   }
   // Borrows the reference
   Node *ValueAt(size_t i) {
-    if (!obj || i >= Size()) return nullptr;
-
     JNIEnv *env = getJNIEnv();
-    jobject val =
-        ObjectMethod(env, "valueAt", METHOD_JNODE_VALUE_AT, CLS_JNODE, obj, i);
-    Node *result = lookupOrCreate(val);
+    if (!obj || i >= size(env)) return nullptr;
+
+    jobject val = ObjectMethod(env, ids.jnodeValueAt, "JNode.valueAt", obj, i);
+    Node *result = lookupOrCreate(env, val);
     env->DeleteLocalRef(val);
     return result;
   }
@@ -391,15 +640,13 @@ class Node : public uast::Node<Node *> {
     // If val->obj does not exist, create a local reference
     // otherwise v would contain a global reference to val->obj
     if (createLocal) {
-      v = NewJavaObject(env, CLS_JNULL, "()V");
+      v = NewJavaObject(env, ids.clsJNull, ids.jnullInit, "JNull");
     } else {
       v = val->obj;
     }
 
-    jobject res = ObjectMethod(getJNIEnv(), "add", METHOD_JARR_ADD, CLS_JARR, obj, v);
-    checkJvmException(std::string("failed to call ")
-                          .append(CLS_JARR)
-                          .append(".add() from Node::SetValue()"));
+    jobject res = ObjectMethod(env, ids.jarrAdd, "JArray.add", obj, v);
+    checkJvmException(env, "failed to call JArray.add() from Node::SetValue()");
 
     env->DeleteLocalRef(res);
     if (createLocal)
@@ -413,19 +660,22 @@ class Node : public uast::Node<Node *> {
     // If val->obj does not exist, create a local reference
     // otherwise v would contain a global reference to val->obj
     if (createLocal) {
-      v = NewJavaObject(env, CLS_JNULL, "()V");
+      v = NewJavaObject(env, ids.clsJNull, ids.jnullInit, "JNull");
     } else {
       v = val->obj;
     }
 
-    jstring k = env->NewStringUTF(key.data());
-    jobject res = ObjectMethod(env, "add", METHOD_JOBJ_ADD, CLS_JOBJ, obj, k, v);
-    checkJvmException(
-        std::string("failed to call JObject.add() from Node::SetKeyValue(")
-            .append(key)
-            .append(")"));
+    bool localKey;
+    jstring k = jstrings.Key(env, key, localKey);
+    jobject res = ObjectMethod(env, ids.jobjAdd, "JObject.add", obj, k, v);
+    if (env->ExceptionCheck()) {
+      checkJvmException(env, std::string("failed to call JObject.add() from Node::SetKeyValue(")
+              .append(key)
+              .append(")"));
+    }
 
-    env->DeleteLocalRef(k);
+    if (localKey)
+      env->DeleteLocalRef(k);
     env->DeleteLocalRef(res);
     if (createLocal)
       env->DeleteLocalRef(v);
@@ -441,11 +691,15 @@ struct EqualByObj {
 };
 
 // Custom hasing function for keys in std::map<object>.
-// Delegates actual hasing to the managed .hashCode() impl.
+// Uses System.identityHashCode(), that is O(1) and stable for the lifetime
+// of an object. The managed .hashCode() of JObject and JArray is structural
+// and would make every lookup O(subtree).
+// The map calls it without an env, getJNIEnv() is a thread-local read.
 struct HashByObj {
   std::size_t operator()(jobject obj) const noexcept {
-    auto hash = IntMethod(getJNIEnv(), "hashCode", "()I", CLS_OBJ, obj);
-    checkJvmException("failed to call hashCode()");
+    JNIEnv *env = getJNIEnv();
+    jint hash = env->CallStaticIntMethod(ids.clsSystem, ids.identityHash, obj);
+    checkJvmException(env, "failed to call System.identityHashCode()");
     return hash;
   }
 };
@@ -454,27 +708,32 @@ class Context;
 
 class Interface : public uast::NodeCreator<Node *> {
  private:
+  // Nodes and their cached strings, released in bulk with the Interface
+  Arena arena;
   std::unordered_map<jobject, Node *, HashByObj, EqualByObj> obj2node;
 
   // lookupOrCreate either creates a new object or returns existing one.
   // In the second case it creates a new reference.
-  Node *lookupOrCreate(jobject obj) {
+  Node *lookupOrCreate(JNIEnv *env, jobject obj) {
     if (!obj) return nullptr;
 
-    if (obj2node.count(obj) > 0) {
-      return obj2node[obj];
+    auto it = obj2node.find(obj);
+    if (it != obj2node.end()) {
+      return it->second;
     }
 
-    Node *node = new Node(this, obj);
+    Node *node = arena.New<Node>(env, this, obj);
     obj2node[node->obj] = node;
+    stats.nodes++;
     return node;
   }
 
   // create makes a new object with a specified kind.
   // Creates new reference.
-  Node *create(NodeKind kind, jobject obj) {
-    Node *node = new Node(this, kind, obj);
+  Node *create(JNIEnv *env, NodeKind kind, jobject obj) {
+    Node *node = arena.New<Node>(env, this, kind, obj);
     obj2node[node->obj] = node;
+    stats.nodes++;
     return node;
   }
 
@@ -484,13 +743,18 @@ class Interface : public uast::NodeCreator<Node *> {
 
   Interface() {}
   ~Interface() {
-    // Only needs to deallocate Nodes, since they own
+    // Only needs to release the Nodes, since they own
     // the same object as used in the map key.
+    // Their memory is released with the arena.
     for (auto it : obj2node) {
-      delete (it.second);
+      it.second->~Node();
     }
+    stats.nodes -= obj2node.size();
   }
 
+  // ArenaBytes returns the memory held for the nodes.
+  size_t ArenaBytes() { return arena.Bytes(); }
+
   // toJ returns a JVM object associated with a node.
   // It borrows the reference
   jobject toJ(Node *node) {
@@ -501,59 +765,62 @@ class Interface : public uast::NodeCreator<Node *> {
   // abstract methods from NodeCreator
   Node *NewObject(size_t size) {
     JNIEnv *env = getJNIEnv();
-    jobject m = NewJavaObject(env, CLS_JOBJ, "()V");
-    checkJvmException("failed to create new " + std::string(CLS_JOBJ));
-    Node *result = create(NODE_OBJECT, m);
+    jobject m = NewJavaObject(env, ids.clsJObj, ids.jobjInit, "JObject");
+    checkJvmException(env, "failed to create new JObject");
+    Node *result = create(env, NODE_OBJECT, m);
     env->DeleteLocalRef(m);
     return result;
   }
   Node *NewArray(size_t size) {
     JNIEnv *env = getJNIEnv();
-    jobject arr = NewJavaObject(env, CLS_JARR, "(I)V", size);
-    checkJvmException("failed to create new " + std::string(CLS_JARR));
-    Node *result = create(NODE_ARRAY, arr);
+    jobject arr = NewJavaObject(env, ids.clsJArr, ids.jarrInit, "JArray", size);
+    checkJvmException(env, "failed to create new JArray");
+    Node *result = create(env, NODE_ARRAY, arr);
     env->DeleteLocalRef(arr);
     return result;
   }
   Node *NewString(std::string v) {
     JNIEnv *env = getJNIEnv();
-    jobject str = env->NewStringUTF(v.data());
-    jobject arr = NewJavaObject(env, CLS_JSTR, "(Ljava/lang/String;)V", str);
-    checkJvmException("failed to create new " + std::string(CLS_JSTR));
-    Node *result = create(NODE_STRING, arr);
-    env->DeleteLocalRef(str);
+    // frequent short values, like @type and roles, are shared by all trees
+    bool localStr;
+    jobject str = jstrings.Value(env, v, localStr);
+    jobject arr = NewJavaObject(env, ids.clsJStr, ids.jstrInit, "JString", str);
+    checkJvmException(env, "failed to create new JString");
+    Node *result = create(env, NODE_STRING, arr);
+    if (localStr)
+      env->DeleteLocalRef(str);
     env->DeleteLocalRef(arr);
     return result;
   }
   Node *NewInt(int64_t v) {
     JNIEnv *env = getJNIEnv();
-    jobject i = NewJavaObject(env, CLS_JINT, "(J)V", v);
-    checkJvmException("failed to create new " + std::string(CLS_JINT));
-    Node *result = create(NODE_INT, i);
+    jobject i = NewJavaObject(env, ids.clsJInt, ids.jintInit, "JInt", v);
+    checkJvmException(env, "failed to create new JInt");
+    Node *result = create(env, NODE_INT, i);
     env->DeleteLocalRef(i);
     return result;
   }
   Node *NewUint(uint64_t v) {
     JNIEnv *env = getJNIEnv();
-    jobject i = NewJavaObject(env, CLS_JUINT, "(J)V", v);
-    checkJvmException("failed to create new " + std::string(CLS_JUINT));
-    Node *result = create(NODE_UINT, i);
+    jobject i = NewJavaObject(env, ids.clsJUint, ids.juintInit, "JUint", v);
+    checkJvmException(env, "failed to create new JUint");
+    Node *result = create(env, NODE_UINT, i);
     env->DeleteLocalRef(i);
     return result;
   }
   Node *NewFloat(double v) {
     JNIEnv *env = getJNIEnv();
-    jobject i = NewJavaObject(env, CLS_JFLT, "(D)V", v);
-    checkJvmException("failed to create new " + std::string(CLS_JFLT));
-    Node *result = create(NODE_FLOAT, i);
+    jobject i = NewJavaObject(env, ids.clsJFlt, ids.jfltInit, "JFloat", v);
+    checkJvmException(env, "failed to create new JFloat");
+    Node *result = create(env, NODE_FLOAT, i);
     env->DeleteLocalRef(i);
     return result;
   }
   Node *NewBool(bool v) {
     JNIEnv *env = getJNIEnv();
-    jobject i = NewJavaObject(env, CLS_JBOOL, "(Z)V", v);
-    checkJvmException("failed to create new " + std::string(CLS_JBOOL));
-    Node *result = create(NODE_BOOL, i);
+    jobject i = NewJavaObject(env, ids.clsJBool, ids.jboolInit, "JBool", v);
+    checkJvmException(env, "failed to create new JBool");
+    Node *result = create(env, NODE_BOOL, i);
     env->DeleteLocalRef(i);
     return result;
   }
@@ -563,9 +830,27 @@ class Interface : public uast::NodeCreator<Node *> {
 // Returns a borrowed reference.
 jobject Node::toJ() { return iface->toJ(this); }
 
+std::string *Node::AsString() {  // new ref
+  if (!str) {
+    JNIEnv *env = getJNIEnv();
+    jstring jstr = (jstring)ObjectMethod(env, ids.jstrStr, "JString.str", obj);
+
+    // not ScratchString, that may hold the query being evaluated
+    static thread_local std::string scratch;
+    ReadString(env, jstr, scratch);
+    strLen = scratch.size();
+    str = iface->arena.CopyString(scratch.data(), strLen);
+    env->DeleteLocalRef(jstr);
+  }
+
+  return new std::string(str, strLen);
+}
+
 // lookupOrCreate either creates a new object or returns existing one.
 // In the second case it creates a new reference.
-Node *Node::lookupOrCreate(jobject obj) { return iface->lookupOrCreate(obj); }
+Node *Node::lookupOrCreate(JNIEnv *env, jobject obj) {
+  return iface->lookupOrCreate(env, obj);
+}
 
 class Context {
  private:
@@ -581,7 +866,9 @@ class Context {
   }
   // toNode returns a node associated with a JVM object.
   // Returns a new reference.
-  Node *toNode(jobject jnode) { return iface->lookupOrCreate(jnode); }
+  Node *toNode(jobject jnode) {
+    return iface->lookupOrCreate(getJNIEnv(), jnode);
+  }
 
  public:
   Context() {
@@ -591,13 +878,18 @@ class Context {
     impl = new uast::PtrInterface<Node *>(iface);
     // create a new UAST context based on this implementation
     ctx = impl->NewContext();
+    stats.contexts++;
   }
   ~Context() {
     delete (ctx);
     delete (impl);
     delete (iface);
+    stats.contexts--;
   }
 
+  // ArenaBytes returns the memory held for the node mirrors.
+  size_t ArenaBytes() { return iface->ArenaBytes(); }
+
   // RootNode returns a root UAST node, if set.
   // Returns a borrowed ref
   jobject RootNode() {
@@ -629,187 +921,912 @@ class Context {
 
   // Encode serializes UAST.
   // Creates a new reference.
-  jobject Encode(jobject jnode, UastFormat format) {
+  jbyteArray Encode(jobject jnode, UastFormat format) {
     if (!assertNotContext(jnode)) return nullptr;
 
     Node *n = toNode(jnode);
     uast::Buffer data = ctx->Encode(n, format);
-    return asJvmBuffer(data);
+    return asJvmArray(data);
   }
 
   jobject LoadFrom(jobject src) {  // NodeExt
     JNIEnv *env = getJNIEnv();
     // NodeExt contains a ctx: ContextExt (JVM ref) and a nativeContext: ContextExt (handle)
-    jobject jCtxExt = ObjectField(env, src, "ctx", FIELD_CTX_EXT);
-    ContextExt *nodeExtCtx = getHandle<ContextExt>(env, jCtxExt, nativeContext);
-
-    if (!nodeExtCtx) {
-      checkJvmException("failed to get NodeExt.ctx");
-      return nullptr;
-    }
+    jobject jCtxExt = ObjectField(env, src, ids.nodeCtx, "NodeExt.ctx");
+    ContextExt *nodeExtCtx =
+        liveHandle<ContextExt>(env, jCtxExt, ids.ctxExtNative, "ContextExt");
+    if (!nodeExtCtx) return nullptr;
     auto sctx = nodeExtCtx->ctx;
     NodeHandle snode =
-        reinterpret_cast<NodeHandle>(getHandle<NodeHandle>(env, src, "handle"));
-    checkJvmException("failed to get NodeExt.handle");
+        reinterpret_cast<NodeHandle>(getHandle<NodeHandle>(env, src, ids.nodeHandle, "NodeExt.handle"));
+    checkJvmException(env, "failed to get NodeExt.handle");
 
     Node *node = uast::Load(sctx, snode, ctx);
     return toJ(node);
   }
 };
 
-}  // namespace
+// ================================================
+// Native UAST mirror (no JVM objects involved)
+// ================================================
+class NativeInterface;
 
-// ==========================================
-//          v2.libuast.Libuast
-// ==========================================
+// NativeNode is a plain C++ copy of a UAST node.
+class NativeNode : public uast::Node<NativeNode *> {
+ private:
+  NativeInterface *iface;
+  NodeKind kind;
+  // preorder index in the flat buffer the node was read from, or -1
+  int32_t index;
+  union {
+    int64_t i;
+    uint64_t u;
+    double f;
+    bool b;
+  } val;
+  std::string str;
+  // object keys are interned by NativeInterface
+  std::vector<const std::string *> keys;
+  // object or array values, nullptr is a null node
+  std::vector<NativeNode *> values;
 
-JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_decode(
-    JNIEnv *env, jobject self, jobject directBuf, jint fmt) {
-  UastFormat format = (UastFormat) fmt;
+ public:
+  friend class NativeInterface;
+  friend class NativeTree;
+  friend class FlatWriter;
+  friend class FlatReader;
 
-  // works only with ByteBuffer.allocateDirect()
-  void *buf = env->GetDirectBufferAddress(directBuf);
-  checkJvmException("failed to use buffer for direct access");
+  NativeNode(NativeInterface *i, NodeKind k) : iface(i), kind(k), index(-1) {
+    val.i = 0;
+  }
 
-  jlong len = env->GetDirectBufferCapacity(directBuf);
-  checkJvmException("failed to get buffer capacity");
-  jobject jCtxExt = nullptr;
+  int32_t Index() { return index; }
 
-  try {
-      // another option (instead of XXX) is to use
-      // GetPrimitiveArrayCritical
-      // Note the content of buf will be released by the JVM itself
-      uast::Buffer ubuf(buf, (size_t)(len));
-      uast::Context<NodeHandle> *ctx = uast::Decode(ubuf, format);
-      // ReleasePrimitiveArrayCritical
+  NodeKind Kind() { return kind; }
+
+  std::string *AsString() { return new std::string(str); }
+  int64_t AsInt() { return val.i; }
+  uint64_t AsUint() { return val.u; }
+  double AsFloat() { return val.f; }
+  bool AsBool() { return val.b; }
 
-      ContextExt *p = new ContextExt(ctx);
+  size_t Size() {
+    if (kind == NODE_STRING) return str.size();
+    return values.size();
+  }
+  std::string *KeyAt(size_t i) {
+    if (i >= keys.size()) return nullptr;
+    return new std::string(*keys[i]);
+  }
+  NativeNode *ValueAt(size_t i) {
+    if (i >= values.size()) return nullptr;
+    return values[i];
+  }
+  void SetValue(size_t i, NativeNode *v) {
+    if (i >= values.size()) values.resize(i + 1);
+    values[i] = v;
+  }
+  void SetKeyValue(std::string k, NativeNode *v);
 
-      jCtxExt = NewJavaObject(env, CLS_CTX_EXT, "(J)V", p);
+  // Borrowed key of the i-th field of an object, nullptr if there is none.
+  const std::string *Key(size_t i) {
+    return i < keys.size() ? keys[i] : nullptr;
+  }
+  // Value of the given field of an object, nullptr if there is none.
+  NativeNode *Get(const std::string &k) {
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (*keys[i] == k) return values[i];
+    }
+    return nullptr;
+  }
+  const std::string &Str() { return str; }
+};
 
-      // Saves weak reference to JVM ContextExt in the native ContextExt
-      p->setManagedContext(jCtxExt);
+// NativeInterface creates and owns NativeNodes.
+class NativeInterface : public uast::NodeCreator<NativeNode *> {
+ private:
+  std::deque<NativeNode> nodes;
+  std::unordered_set<std::string> keys;
 
-      if (env->ExceptionCheck() || !jCtxExt) {
-          jCtxExt = nullptr;
-          // This also deletes the underlying ctx
-          delete (p);
-          checkJvmException("failed to instantiate ContextExt class");
-      }
-  } catch (const std::exception &e) {
-    ThrowByName(env, CLS_RE, e.what());
+  NativeNode *create(NodeKind kind) {
+    nodes.emplace_back(this, kind);
+    return &nodes.back();
   }
 
-  return jCtxExt;
-}
+ public:
+  friend class NativeNode;
 
-// UastIter
-JNIEXPORT void JNICALL
-Java_org_bblfsh_client_v2_libuast_Libuast_00024UastIter_nativeInit(
-    JNIEnv *env, jobject self) {
-  jobject jnode = ObjectField(env, self, "node", FIELD_ITER_NODE);
-  if (!jnode) {
-    return;
+  const std::string *intern(const std::string &key) {
+    return &*keys.insert(key).first;
   }
 
-  Context *ctx = new Context();
-  jobject jCtx = NewJavaObject(env, CLS_CTX, "(J)V", ctx);
+  // abstract methods from NodeCreator
+  NativeNode *NewObject(size_t size) {
+    NativeNode *node = create(NODE_OBJECT);
+    node->keys.reserve(size);
+    node->values.reserve(size);
+    return node;
+  }
+  NativeNode *NewArray(size_t size) {
+    NativeNode *node = create(NODE_ARRAY);
+    node->values.reserve(size);
+    return node;
+  }
+  NativeNode *NewString(std::string v) {
+    NativeNode *node = create(NODE_STRING);
+    node->str = std::move(v);
+    return node;
+  }
+  NativeNode *NewInt(int64_t v) {
+    NativeNode *node = create(NODE_INT);
+    node->val.i = v;
+    return node;
+  }
+  NativeNode *NewUint(uint64_t v) {
+    NativeNode *node = create(NODE_UINT);
+    node->val.u = v;
+    return node;
+  }
+  NativeNode *NewFloat(double v) {
+    NativeNode *node = create(NODE_FLOAT);
+    node->val.f = v;
+    return node;
+  }
+  NativeNode *NewBool(bool v) {
+    NativeNode *node = create(NODE_BOOL);
+    node->val.b = v;
+    return node;
+  }
+};
 
-  jint order = IntField(env, self, "treeOrder", "I");
-  if (order < 0) {
-    return;
+// NativeTree is a native, JVM-independent copy of a UAST subtree.
+//
+// All the nodes are owned by the tree and released with it.
+class NativeTree {
+ private:
+  NativeInterface *iface;
+  uast::PtrInterface<NativeNode *> *impl;
+  uast::Context<NativeNode *> *ctx;
+  NativeNode *root;
+
+ public:
+  NativeTree() : root(nullptr) {
+    iface = new NativeInterface();
+    impl = new uast::PtrInterface<NativeNode *>(iface);
+    ctx = impl->NewContext();
+  }
+  ~NativeTree() {
+    delete (ctx);
+    delete (impl);
+    delete (iface);
   }
 
-  // global ref will be deleted by Interface destructor on ctx deletion
-  auto it = ctx->Iterate(jnode, (TreeOrder)order);
+  NativeNode *Root() { return root; }
 
-  // this.iter = it;
-  setHandle<uast::Iterator<Node *>>(env, self, it, "iter");
-  // this.ctx = Context(ctx);
-  setObjectField(env, self, jCtx, "ctx", FIELD_CTX);
+  // LoadFrom copies the subtree of the given NodeExt.
+  // Borrows the reference. Returns false if there is a pending JVM exception.
+  bool LoadFrom(JNIEnv *env, jobject nodeExt) {
+    jobject jCtxExt = ObjectField(env, nodeExt, ids.nodeCtx, "NodeExt.ctx");
+    ContextExt *src =
+        liveHandle<ContextExt>(env, jCtxExt, ids.ctxExtNative, "ContextExt");
+    if (jCtxExt) env->DeleteLocalRef(jCtxExt);
+    if (!src) return false;
 
-  return;
-}
+    auto handle = (NodeHandle)LongField(env, nodeExt, ids.nodeHandle, "NodeExt.handle");
+    if (env->ExceptionCheck()) return false;
 
-JNIEXPORT void JNICALL
-Java_org_bblfsh_client_v2_libuast_Libuast_00024UastIter_nativeDispose(
-    JNIEnv *env, jobject self) {
-  // this.ctx will be disposed by Context finalizer
-  setObjectField(env, self, nullptr, "ctx", FIELD_CTX);
+    LoadFrom(src, handle);
+    return true;
+  }
 
-  // this.iter
-  auto iter = getHandle<uast::Iterator<Node *>>(env, self, "iter");
-  setHandle<uast::Iterator<Node *>>(env, self, 0, "iter");
-  delete (iter);
-  return;
-}
+  // LoadFrom copies the subtree of an external node.
+  void LoadFrom(ContextExt *src, NodeHandle node) {
+    root = uast::Load(src->ctx, node, ctx);
+  }
 
-JNIEXPORT jobject JNICALL
-Java_org_bblfsh_client_v2_libuast_Libuast_00024UastIter_nativeNext(
-    JNIEnv *env, jobject self, jlong iterPtr) {
-  // this.iter
-  auto iter = reinterpret_cast<uast::Iterator<Node *> *>(iterPtr);
+  // LoadFlat reads the tree from the flat preorder format of FlatWriter.
+  // Every node gets its preorder index. Throws on malformed input.
+  void LoadFlat(const char *data, size_t size);
 
-  try {
-    if (!iter->next()) {
-      return nullptr;
-    }
-  } catch (const std::exception &e) {
-    ThrowByName(env, CLS_RE, e.what());
-    return nullptr;
+  // Filter queries the tree, results may include new value nodes
+  // created by the query, that are owned by the tree as well.
+  uast::Iterator<NativeNode *> *Filter(const std::string &query) {
+    return ctx->Filter(root, query);
   }
 
-  Node *node = iter->node();
-  if (!node) return nullptr;
+  // Encode serializes the tree, without any calls to the JVM.
+  uast::Buffer Encode(UastFormat format) { return ctx->Encode(root, format); }
+};
 
-  return node->toJ();  // borrows ref
+void NativeNode::SetKeyValue(std::string k, NativeNode *v) {
+  keys.push_back(iface->intern(k));
+  values.push_back(v);
 }
 
-// UastIterExt
-JNIEXPORT void JNICALL
-Java_org_bblfsh_client_v2_libuast_Libuast_00024UastIterExt_nativeInit(
-    JNIEnv *env, jobject self) {  // sets iter and ctx, given node: NodeExt
+// ScalarNode keeps only the kind of a node and the value of a scalar,
+// objects and arrays are left empty.
+class ScalarNode : public uast::Node<ScalarNode *> {
+ private:
+  NodeKind kind;
+  union {
+    int64_t i;
+    uint64_t u;
+    double f;
+    bool b;
+  } val;
+  std::string str;
 
-  jobject nodeExt = ObjectField(env, self, "node", FIELD_ITER_NODE);
-  if (!nodeExt) {
-    return;
+ public:
+  friend class ScalarReader;
+
+  ScalarNode() : kind(NODE_NULL) { val.i = 0; }
+
+  NodeKind Kind() { return kind; }
+
+  std::string *AsString() { return new std::string(str); }
+  int64_t AsInt() { return val.i; }
+  uint64_t AsUint() { return val.u; }
+  double AsFloat() { return val.f; }
+  bool AsBool() { return val.b; }
+
+  size_t Size() { return kind == NODE_STRING ? str.size() : 0; }
+  std::string *KeyAt(size_t i) { return nullptr; }
+  ScalarNode *ValueAt(size_t i) { return nullptr; }
+  void SetValue(size_t i, ScalarNode *v) {}
+  void SetKeyValue(std::string k, ScalarNode *v) {}
+};
+
+// ScalarReader reads the values of external nodes, one at a time.
+//
+// libuast only gives access to a decoded node through uast::Load, so the
+// node is still loaded, but into a pool of ScalarNodes that is reused by
+// every Read: the subtrees of objects and arrays are neither linked nor
+// kept, and the memory used is bounded by the largest result.
+class ScalarReader : public uast::NodeCreator<ScalarNode *> {
+ private:
+  std::deque<ScalarNode> nodes;
+  size_t used;
+  uast::PtrInterface<ScalarNode *> *impl;
+  uast::Context<ScalarNode *> *ctx;
+
+  ScalarNode *create(NodeKind kind) {
+    if (used == nodes.size()) nodes.emplace_back();
+    ScalarNode *node = &nodes[used++];
+    node->kind = kind;
+    return node;
   }
 
-  jobject jCtxExt = ObjectField(env, nodeExt, "ctx", FIELD_CTX_EXT);
-  if (!jCtxExt)
+ public:
+  ScalarReader() : used(0) {
+    impl = new uast::PtrInterface<ScalarNode *>(this);
+    ctx = impl->NewContext();
+  }
+  ~ScalarReader() {
+    delete (ctx);
+    delete (impl);
+  }
+
+  // Read returns the given node, valid until the next call.
+  ScalarNode *Read(ContextExt *src, NodeHandle node) {
+    used = 0;
+    return uast::Load(src->ctx, node, ctx);
+  }
+
+  // abstract methods from NodeCreator
+  ScalarNode *NewObject(size_t size) { return create(NODE_OBJECT); }
+  ScalarNode *NewArray(size_t size) { return create(NODE_ARRAY); }
+  ScalarNode *NewString(std::string v) {
+    ScalarNode *node = create(NODE_STRING);
+    node->str = std::move(v);
+    return node;
+  }
+  ScalarNode *NewInt(int64_t v) {
+    ScalarNode *node = create(NODE_INT);
+    node->val.i = v;
+    return node;
+  }
+  ScalarNode *NewUint(uint64_t v) {
+    ScalarNode *node = create(NODE_UINT);
+    node->val.u = v;
+    return node;
+  }
+  ScalarNode *NewFloat(double v) {
+    ScalarNode *node = create(NODE_FLOAT);
+    node->val.f = v;
+    return node;
+  }
+  ScalarNode *NewBool(bool v) {
+    ScalarNode *node = create(NODE_BOOL);
+    node->val.b = v;
+    return node;
+  }
+};
+
+// ================================================
+// Flat preorder format of a UAST subtree
+// ================================================
+//
+// All values are in the native byte order:
+//   int32 number of strings, then for each: int32 length and UTF-8 bytes
+//   nodes in preorder, each is an uint8 NodeKind followed by
+//     NODE_OBJECT: int32 size, then size times an int32 key index and a node
+//     NODE_ARRAY:  int32 size, then size nodes
+//     NODE_STRING: int32 string index
+//     NODE_INT, NODE_UINT: int64
+//     NODE_FLOAT:  float64
+//     NODE_BOOL:   uint8
+//     NODE_NULL:   nothing
+//
+// Keys and string values share the same table, each string is stored once.
+class FlatWriter {
+ private:
+  std::unordered_map<std::string, int32_t> index;
+  std::vector<const std::string *> strings;
+  size_t stringBytes;
+  std::string nodes;
+
+  template <typename T>
+  static void put(std::string &out, T v) {
+    out.append(reinterpret_cast<const char *>(&v), sizeof(T));
+  }
+
+  int32_t intern(const std::string &str) {
+    auto it = index.find(str);
+    if (it != index.end()) return it->second;
+
+    int32_t i = (int32_t)strings.size();
+    strings.push_back(&index.emplace(str, i).first->first);
+    stringBytes += sizeof(int32_t) + str.size();
+    return i;
+  }
+
+ public:
+  FlatWriter() : stringBytes(sizeof(int32_t)) {}
+
+  // Write appends the subtree of the given node.
+  void Write(NativeNode *node) {
+    if (!node) {
+      put<uint8_t>(nodes, NODE_NULL);
+      return;
+    }
+    put<uint8_t>(nodes, node->kind);
+    switch (node->kind) {
+      case NODE_OBJECT:
+        put<int32_t>(nodes, node->values.size());
+        for (size_t i = 0; i < node->values.size(); i++) {
+          put<int32_t>(nodes, intern(*node->keys[i]));
+          Write(node->values[i]);
+        }
+        break;
+      case NODE_ARRAY:
+        put<int32_t>(nodes, node->values.size());
+        for (auto v : node->values) Write(v);
+        break;
+      case NODE_STRING:
+        put<int32_t>(nodes, intern(node->str));
+        break;
+      case NODE_INT:
+        put<int64_t>(nodes, node->val.i);
+        break;
+      case NODE_UINT:
+        put<uint64_t>(nodes, node->val.u);
+        break;
+      case NODE_FLOAT:
+        put<double>(nodes, node->val.f);
+        break;
+      case NODE_BOOL:
+        put<uint8_t>(nodes, node->val.b ? 1 : 0);
+        break;
+      default:
+        break;
+    }
+  }
+
+  // Size of the whole encoded buffer, in bytes.
+  size_t Size() { return stringBytes + nodes.size(); }
+
+  // CopyTo writes the string table followed by the nodes to dst,
+  // that must be at least Size() bytes long.
+  void CopyTo(char *dst) {
+    int32_t n = strings.size();
+    memcpy(dst, &n, sizeof(n));
+    dst += sizeof(n);
+    for (auto str : strings) {
+      int32_t len = str->size();
+      memcpy(dst, &len, sizeof(len));
+      dst += sizeof(len);
+      memcpy(dst, str->data(), str->size());
+      dst += str->size();
+    }
+    memcpy(dst, nodes.data(), nodes.size());
+  }
+
+  // NewDirectBuffer copies the result to a new direct ByteBuffer, owned
+  // by the JVM. Returns a local reference or nullptr if an exception is
+  // pending.
+  jobject NewDirectBuffer(JNIEnv *env) {
+    size_t size = Size();
+    if (size > INT32_MAX) {
+      ThrowRuntime(env, "UAST is too large for a flat buffer");
+      return nullptr;
+    }
+    jobject buf = env->CallStaticObjectMethod(
+        ids.clsByteBuf, ids.byteBufAllocDirect, (jint)size);
+    if (env->ExceptionCheck() || !buf) return nullptr;
+
+    CopyTo(static_cast<char *>(env->GetDirectBufferAddress(buf)));
+    return buf;
+  }
+
+  // NewStringBuffer writes only the string table to a new direct ByteBuffer,
+  // in the same layout as the string table of a flat UAST.
+  static jobject NewStringBuffer(JNIEnv *env,
+                                 const std::vector<std::string> &strs) {
+    FlatWriter out;
+    out.strings.reserve(strs.size());
+    for (auto &str : strs) {
+      out.strings.push_back(&str);
+      out.stringBytes += sizeof(int32_t) + str.size();
+    }
+    return out.NewDirectBuffer(env);
+  }
+};
+
+// FlatReader builds native nodes from the flat preorder format of
+// FlatWriter, that is also written by FlatJNode on the JVM side.
+class FlatReader {
+ private:
+  NativeInterface *iface;
+  const char *pos;
+  const char *end;
+  std::vector<std::string> strings;
+  int32_t next;  // preorder index of the next node
+
+  template <typename T>
+  T get() {
+    if (size_t(end - pos) < sizeof(T)) {
+      throw std::runtime_error("truncated flat UAST buffer");
+    }
+    T v;
+    memcpy(&v, pos, sizeof(T));
+    pos += sizeof(T);
+    return v;
+  }
+
+  int32_t getSize() {
+    int32_t n = get<int32_t>();
+    if (n < 0) throw std::runtime_error("negative size in flat UAST buffer");
+    return n;
+  }
+
+  const std::string &getString() {
+    int32_t i = get<int32_t>();
+    if (i < 0 || size_t(i) >= strings.size()) {
+      throw std::runtime_error("string index out of range in flat UAST buffer");
+    }
+    return strings[i];
+  }
+
+  NativeNode *node() {
+    int32_t index = next++;
+    NativeNode *node = nullptr;
+    switch (get<uint8_t>()) {
+      case NODE_OBJECT: {
+        int32_t n = getSize();
+        node = iface->NewObject(n);
+        for (int32_t i = 0; i < n; i++) {
+          const std::string &key = getString();
+          node->SetKeyValue(key, this->node());
+        }
+        break;
+      }
+      case NODE_ARRAY: {
+        int32_t n = getSize();
+        node = iface->NewArray(n);
+        for (int32_t i = 0; i < n; i++) {
+          node->values.push_back(this->node());
+        }
+        break;
+      }
+      case NODE_STRING:
+        node = iface->NewString(getString());
+        break;
+      case NODE_INT:
+        node = iface->NewInt(get<int64_t>());
+        break;
+      case NODE_UINT:
+        node = iface->NewUint(get<uint64_t>());
+        break;
+      case NODE_FLOAT:
+        node = iface->NewFloat(get<double>());
+        break;
+      case NODE_BOOL:
+        node = iface->NewBool(get<uint8_t>() != 0);
+        break;
+      case NODE_NULL:
+        return nullptr;
+      default:
+        throw std::runtime_error("unknown node kind in flat UAST buffer");
+    }
+    node->index = index;
+    return node;
+  }
+
+ public:
+  FlatReader(NativeInterface *i, const char *data, size_t size)
+      : iface(i), pos(data), end(data + size), next(0) {}
+
+  // Read returns the root node of the buffer.
+  NativeNode *Read() {
+    int32_t n = getSize();
+    strings.reserve(n);
+    for (int32_t i = 0; i < n; i++) {
+      int32_t len = getSize();
+      if (end - pos < len) throw std::runtime_error("truncated flat UAST buffer");
+      strings.emplace_back(pos, len);
+      pos += len;
+    }
+    return node();
+  }
+};
+
+void NativeTree::LoadFlat(const char *data, size_t size) {
+  root = FlatReader(iface, data, size).Read();
+}
+
+// ==========================================
+//          Typed (scalar) query results
+// ==========================================
+
+// Values collects the values of the query results of a single kind,
+// results of other kinds are skipped.
+class Values {
+ private:
+  NodeKind kind;
+  std::vector<jlong> longs;      // NODE_INT and NODE_UINT
+  std::vector<jdouble> doubles;  // NODE_FLOAT
+  std::vector<jboolean> bools;   // NODE_BOOL
+  std::vector<std::string> strs;  // NODE_STRING
+
+ public:
+  explicit Values(NodeKind k) : kind(k) {}
+
+  // Add works with both the JVM (Node) and the native (NativeNode) nodes.
+  template <typename N>
+  void Add(N *node) {
+    if (!node || node->Kind() != kind) return;
+    switch (kind) {
+      case NODE_INT:
+        longs.push_back(node->AsInt());
+        break;
+      case NODE_UINT:
+        longs.push_back(node->AsUint());
+        break;
+      case NODE_FLOAT:
+        doubles.push_back(node->AsFloat());
+        break;
+      case NODE_BOOL:
+        bools.push_back(node->AsBool());
+        break;
+      case NODE_STRING: {
+        std::unique_ptr<std::string> str(node->AsString());
+        strs.push_back(std::move(*str));
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  // ToJava returns long[] for ints and uints, double[] for floats,
+  // boolean[] for bools, and a direct ByteBuffer of the string table format
+  // of FlatWriter for strings. Returns a local reference.
+  jobject ToJava(JNIEnv *env) {
+    switch (kind) {
+      case NODE_INT:
+      case NODE_UINT: {
+        jlongArray arr = env->NewLongArray(longs.size());
+        if (arr) env->SetLongArrayRegion(arr, 0, longs.size(), longs.data());
+        return arr;
+      }
+      case NODE_FLOAT: {
+        jdoubleArray arr = env->NewDoubleArray(doubles.size());
+        if (arr)
+          env->SetDoubleArrayRegion(arr, 0, doubles.size(), doubles.data());
+        return arr;
+      }
+      case NODE_BOOL: {
+        jbooleanArray arr = env->NewBooleanArray(bools.size());
+        if (arr) env->SetBooleanArrayRegion(arr, 0, bools.size(), bools.data());
+        return arr;
+      }
+      case NODE_STRING:
+        return FlatWriter::NewStringBuffer(env, strs);
+      default:
+        ThrowRuntime(env, "only scalar node kinds can be filtered as values");
+        return nullptr;
+    }
+  }
+};
+
+}  // namespace
+
+// ==========================================
+//          v2.libuast.Libuast
+// ==========================================
+
+// Wraps a decoded context into a new JVM ContextExt, that takes the ownership,
+// together with the source of its encoded UAST.
+//
+// libuast does not document whether a decoded context refers to its input,
+// so every decode path assumes it may: the source is kept alive and
+// unchanged for as long as the context, and released after it. It is a file
+// mapping for files and archives, a native copy for heap arrays and a global
+// reference for direct buffers.
+//
+// Deletes the context and throws on failure.
+jobject newContextExt(JNIEnv *env, uast::Context<NodeHandle> *ctx, size_t size,
+                      std::shared_ptr<void> source = nullptr) {
+  ContextExt *p = new ContextExt(ctx, size, std::move(source));
+
+  jobject jCtxExt = NewJavaObject(env, ids.clsCtxExt, ids.ctxExtInit, "ContextExt", p);
+
+  // Saves weak reference to JVM ContextExt in the native ContextExt
+  p->setManagedContext(jCtxExt);
+
+  if (env->ExceptionCheck() || !jCtxExt) {
+    jCtxExt = nullptr;
+    // This also deletes the underlying ctx
+    delete (p);
+    checkJvmException(env, "failed to instantiate ContextExt class");
+  }
+  return jCtxExt;
+}
+
+JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_decode(
+    JNIEnv *env, jobject self, jobject directBuf, jint fmt) {
+  UastFormat format = (UastFormat) fmt;
+
+  // works only with ByteBuffer.allocateDirect()
+  void *buf = env->GetDirectBufferAddress(directBuf);
+  checkJvmException(env, "failed to use buffer for direct access");
+
+  jlong len = env->GetDirectBufferCapacity(directBuf);
+  checkJvmException(env, "failed to get buffer capacity");
+  jobject jCtxExt = nullptr;
+
+  try {
+      // the buffer stays reachable, and its memory allocated, while the
+      // context is in use
+      std::shared_ptr<void> source(NewGlobalRef(env, directBuf), [](void *ref) {
+        JNIEnv *env = getJNIEnv();
+        if (env) DeleteGlobalRef(env, static_cast<jobject>(ref));
+      });
+      uast::Buffer ubuf(buf, (size_t)(len));
+      uast::Context<NodeHandle> *ctx = uast::Decode(ubuf, format);
+
+      jCtxExt = newContextExt(env, ctx, ubuf.size, std::move(source));
+  } catch (const std::exception &e) {
+    ThrowRuntime(env, e.what());
+  }
+
+  return jCtxExt;
+}
+
+JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_decodeBytes(
+    JNIEnv *env, jobject self, jbyteArray bytes, jint off, jint len, jint fmt) {
+  if (!bytes) {
+    ThrowRuntime(env, "cannot decode a null array");
+    return nullptr;
+  }
+  jsize size = env->GetArrayLength(bytes);
+  if (off < 0 || len < 0 || off > size - len) {
+    ThrowRuntime(env, "array range is out of bounds");
+    return nullptr;
+  }
+
+  // The range is copied to native memory owned by the context, instead of
+  // pinning the array and blocking the GC for the whole decoding.
+  std::shared_ptr<void> copy(malloc(len ? len : 1), free);
+  if (!copy) {
+    ThrowRuntime(env, "failed to allocate memory to decode UAST");
+    return nullptr;
+  }
+  env->GetByteArrayRegion(bytes, off, len, static_cast<jbyte *>(copy.get()));
+  if (env->ExceptionCheck()) return nullptr;
+
+  try {
+    uast::Buffer ubuf(copy.get(), (size_t)len);
+    uast::Context<NodeHandle> *ctx = uast::Decode(ubuf, (UastFormat)fmt);
+    return newContextExt(env, ctx, ubuf.size, std::move(copy));
+  } catch (const std::exception &e) {
+    ThrowRuntime(env, e.what());
+  }
+  return nullptr;
+}
+
+JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_decodeFile(
+    JNIEnv *env, jobject self, jstring jpath, jint fmt) {
+  if (!jpath) {
+    ThrowRuntime(env, "cannot decode a null path");
+    return nullptr;
+  }
+
+  try {
+    // the decoder reads the mapped pages directly, the mapping is owned
+    // by the new ContextExt and released when it is disposed
+    auto file = MappedFile::Open(ScratchString(env, jpath));
+    uast::Buffer ubuf(const_cast<char *>(file->Data()), file->Size());
+    uast::Context<NodeHandle> *ctx = uast::Decode(ubuf, (UastFormat)fmt);
+
+    return newContextExt(env, ctx, ubuf.size, std::move(file));
+  } catch (const std::exception &e) {
+    ThrowRuntime(env, e.what());
+  }
+  return nullptr;
+}
+
+JNIEXPORT jlongArray JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_countBatch(
+    JNIEnv *env, jobject self, jobjectArray jbuffers, jobjectArray jqueries,
+    jint fmt, jint threads) {
+  if (!jbuffers || !jqueries) {
+    ThrowRuntime(env, "buffers and queries must not be null");
+    return nullptr;
+  }
+
+  // everything is read from the JVM before the workers start,
+  // they do not make any JNI calls
+  jsize nb = env->GetArrayLength(jbuffers);
+  std::vector<BatchBuffer> buffers;
+  buffers.reserve(nb);
+  for (jsize i = 0; i < nb; i++) {
+    jobject buf = env->GetObjectArrayElement(jbuffers, i);
+    void *data = buf ? env->GetDirectBufferAddress(buf) : nullptr;
+    if (!data) {
+      if (buf) env->DeleteLocalRef(buf);
+      ThrowRuntime(env, "only direct buffers can be decoded in a batch");
+      return nullptr;
+    }
+    // the buffers stay reachable from the array during the call
+    buffers.push_back({static_cast<const char *>(data),
+                       (size_t)env->GetDirectBufferCapacity(buf)});
+    env->DeleteLocalRef(buf);
+  }
+
+  jsize nq = env->GetArrayLength(jqueries);
+  std::vector<std::string> queries;
+  queries.reserve(nq);
+  for (jsize i = 0; i < nq; i++) {
+    jstring jquery = (jstring)env->GetObjectArrayElement(jqueries, i);
+    if (!jquery) {
+      ThrowRuntime(env, "query must not be null");
+      return nullptr;
+    }
+    queries.push_back(ScratchString(env, jquery));
+    env->DeleteLocalRef(jquery);
+  }
+
+  std::vector<int64_t> counts;
+  try {
+    counts = CountBatch(buffers, queries, (UastFormat)fmt,
+                        threads > 0 ? (unsigned)threads : 0);
+  } catch (const std::exception &e) {
+    ThrowRuntime(env, e.what());
+    return nullptr;
+  }
+
+  jlongArray arr = env->NewLongArray((jsize)counts.size());
+  if (!arr) return nullptr;
+  env->SetLongArrayRegion(arr, 0, (jsize)counts.size(),
+                          reinterpret_cast<const jlong *>(counts.data()));
+  return arr;
+}
+
+// UastIter
+JNIEXPORT void JNICALL
+Java_org_bblfsh_client_v2_libuast_Libuast_00024UastIter_nativeInit(
+    JNIEnv *env, jobject self) {
+  jobject jnode = ObjectField(env, self, ids.jiterNode, "UastIter.node");
+  if (!jnode) {
     return;
+  }
 
-  // borrow ContextExt from NodeExt
-  ContextExt *ctx = getHandle<ContextExt>(env, jCtxExt, nativeContext);
+  Context *ctx = new Context();
+  jobject jCtx = NewJavaObject(env, ids.clsCtx, ids.ctxInit, "Context", ctx);
 
-  jint order = IntField(env, self, "treeOrder", "I");
+  jint order = IntField(env, self, ids.jiterOrder, "UastIter.treeOrder");
   if (order < 0) {
     return;
   }
 
-  auto it = ctx->Iterate(nodeExt, (TreeOrder)order);
+  // global ref will be deleted by Interface destructor on ctx deletion
+  auto it = ctx->Iterate(jnode, (TreeOrder)order);
+  if (it) stats.iterators++;
 
   // this.iter = it;
-  setHandle<uast::Iterator<NodeHandle>>(env, self, it, "iter");
-  // this.ctx = jCtxExt;
-  setObjectField(env, self, jCtxExt, "ctx", FIELD_CTX_EXT);
+  setHandle<uast::Iterator<Node *>>(env, self, it, ids.jiterPtr, "UastIter.iter");
+  // this.ctx = Context(ctx);
+  setObjectField(env, self, jCtx, ids.jiterCtx, "UastIter.ctx");
 
   return;
 }
 
 JNIEXPORT void JNICALL
-Java_org_bblfsh_client_v2_libuast_Libuast_00024UastIterExt_nativeDispose(
+Java_org_bblfsh_client_v2_libuast_Libuast_00024UastIter_nativeDispose(
     JNIEnv *env, jobject self) {
-  // this.ctx will be disposed by ContextExt finalizer
-  setObjectField(env, self, nullptr, "ctx", FIELD_CTX_EXT);
+  // this.ctx will be disposed by Context finalizer
+  setObjectField(env, self, nullptr, ids.jiterCtx, "UastIter.ctx");
 
   // this.iter
-  auto iter = getHandle<uast::Iterator<NodeHandle>>(env, self, "iter");
-  setHandle<uast::Iterator<NodeHandle>>(env, self, 0, "iter");
+  auto iter = getHandle<uast::Iterator<Node *>>(env, self, ids.jiterPtr, "UastIter.iter");
+  setHandle<uast::Iterator<Node *>>(env, self, 0, ids.jiterPtr, "UastIter.iter");
+  if (iter) stats.iterators--;
   delete (iter);
   return;
 }
 
+JNIEXPORT jobject JNICALL
+Java_org_bblfsh_client_v2_libuast_Libuast_00024UastIter_nativeNext(
+    JNIEnv *env, jobject self, jlong iterPtr) {
+  // this.iter
+  auto iter = reinterpret_cast<uast::Iterator<Node *> *>(iterPtr);
+
+  try {
+    if (!iter->next()) {
+      return nullptr;
+    }
+  } catch (const std::exception &e) {
+    ThrowRuntime(env, e.what());
+    return nullptr;
+  }
+
+  Node *node = iter->node();
+  if (!node) return nullptr;
+
+  return node->toJ();  // borrows ref
+}
+
+JNIEXPORT jobjectArray JNICALL
+Java_org_bblfsh_client_v2_libuast_Libuast_00024UastIter_nativeNextBatch(
+    JNIEnv *env, jobject self, jlong iterPtr, jint n) {
+  // this.iter
+  auto iter = reinterpret_cast<uast::Iterator<Node *> *>(iterPtr);
+
+  std::vector<Node *> nodes;
+  try {
+    while (iter && nodes.size() < size_t(n) && iter->next()) {
+      Node *node = iter->node();
+      if (!node) break;
+      nodes.push_back(node);
+    }
+  } catch (const std::exception &e) {
+    ThrowRuntime(env, e.what());
+    return nullptr;
+  }
+
+  jobjectArray batch = env->NewObjectArray(nodes.size(), ids.clsJNode, nullptr);
+  checkJvmException(env, "failed to allocate a batch of JNode");
+  if (!batch) return nullptr;
+
+  for (size_t i = 0; i < nodes.size(); i++) {
+    env->SetObjectArrayElement(batch, i, nodes[i]->toJ());  // borrows ref
+  }
+  return batch;
+}
+
+// UastIterExt
+JNIEXPORT void JNICALL
+Java_org_bblfsh_client_v2_libuast_Libuast_00024UastIterExt_nativeInit(
+    JNIEnv *env, jobject self) {  // sets iter and ctx, given node: NodeExt
+  initIterExt(env, self, ids.iterNode, ids.iterOrder, ids.iterPtr, ids.iterCtx);
+}
+
+JNIEXPORT void JNICALL
+Java_org_bblfsh_client_v2_libuast_Libuast_00024UastIterExt_nativeDispose(
+    JNIEnv *env, jobject self) {
+  disposeIterExt(env, self, ids.iterPtr, ids.iterCtx);
+}
+
 JNIEXPORT jobject JNICALL
 Java_org_bblfsh_client_v2_libuast_Libuast_00024UastIterExt_nativeNext(
     JNIEnv *env, jobject self, jlong iterPtr) {
@@ -821,53 +1838,163 @@ Java_org_bblfsh_client_v2_libuast_Libuast_00024UastIterExt_nativeNext(
       return nullptr;
     }
   } catch (const std::exception &e) {
-    ThrowByName(env, CLS_RE, e.what());
+    ThrowRuntime(env, e.what());
     return nullptr;
   }
 
   NodeHandle node = iter->node();
   if (node == 0) return nullptr;
 
-  jobject jCtxExt = ObjectField(env, self, "ctx", FIELD_CTX_EXT);
-  ContextExt *ctx = getHandle<ContextExt>(env, jCtxExt, nativeContext);
+  jobject jCtxExt = ObjectField(env, self, ids.iterCtx, "UastIterExt.ctx");
+  ContextExt *ctx =
+      liveHandle<ContextExt>(env, jCtxExt, ids.ctxExtNative, "ContextExt");
+  if (!ctx) return nullptr;
   return ctx->lookup(node);
 }
 
+JNIEXPORT jobjectArray JNICALL
+Java_org_bblfsh_client_v2_libuast_Libuast_00024UastIterExt_nativeNextBatch(
+    JNIEnv *env, jobject self, jlong iterPtr, jint n) {
+  // this.iter
+  auto iter = reinterpret_cast<uast::Iterator<NodeHandle> *>(iterPtr);
+
+  std::vector<NodeHandle> nodes;
+  try {
+    while (iter && nodes.size() < size_t(n) && iter->next()) {
+      NodeHandle node = iter->node();
+      if (node == 0) break;
+      nodes.push_back(node);
+    }
+  } catch (const std::exception &e) {
+    ThrowRuntime(env, e.what());
+    return nullptr;
+  }
+
+  jobjectArray batch = env->NewObjectArray(nodes.size(), ids.clsNode, nullptr);
+  checkJvmException(env, "failed to allocate a batch of NodeExt");
+  if (!batch || nodes.empty()) return batch;
+
+  // this.ctx is read once per batch
+  jobject jCtxExt = ObjectField(env, self, ids.iterCtx, "UastIterExt.ctx");
+  ContextExt *ctx =
+      liveHandle<ContextExt>(env, jCtxExt, ids.ctxExtNative, "ContextExt");
+  if (!ctx) return nullptr;
+  for (size_t i = 0; i < nodes.size(); i++) {
+    jobject node = ctx->lookup(nodes[i]);
+    env->SetObjectArrayElement(batch, i, node);
+    // keeps the number of local refs constant for any batch size
+    env->DeleteLocalRef(node);
+  }
+  env->DeleteLocalRef(jCtxExt);
+  return batch;
+}
+
+// UastHandleIter
+JNIEXPORT void JNICALL
+Java_org_bblfsh_client_v2_libuast_Libuast_00024UastHandleIter_nativeInit(
+    JNIEnv *env, jobject self) {  // sets iter and ctx, given node: NodeExt
+  initIterExt(env, self, ids.handleIterNode, ids.handleIterOrder,
+              ids.handleIterPtr, ids.handleIterCtx);
+}
+
+JNIEXPORT void JNICALL
+Java_org_bblfsh_client_v2_libuast_Libuast_00024UastHandleIter_nativeDispose(
+    JNIEnv *env, jobject self) {
+  disposeIterExt(env, self, ids.handleIterPtr, ids.handleIterCtx);
+}
+
+JNIEXPORT jint JNICALL
+Java_org_bblfsh_client_v2_libuast_Libuast_00024UastHandleIter_nativeNextHandles(
+    JNIEnv *env, jobject self, jlong iterPtr, jlongArray out) {
+  // this.iter
+  auto iter = reinterpret_cast<uast::Iterator<NodeHandle> *>(iterPtr);
+  if (!iter) return 0;
+
+  jsize cap = env->GetArrayLength(out);
+  std::vector<jlong> handles;
+  handles.reserve(cap);
+  try {
+    while (handles.size() < size_t(cap) && iter->next()) {
+      NodeHandle node = iter->node();
+      if (node == 0) break;
+      handles.push_back(jlong(node));
+    }
+  } catch (const std::exception &e) {
+    ThrowRuntime(env, e.what());
+    return 0;
+  }
+
+  env->SetLongArrayRegion(out, 0, handles.size(), handles.data());
+  return handles.size();
+}
+
 // ==========================================
 //              v2.Context()
 // ==========================================
 
-JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_Context_filter(
-    JNIEnv *env, jobject self, jstring jquery, jobject jnode) {
-  Context *ctx = getHandle<Context>(env, self, nativeContext);
-
-  const char *q = env->GetStringUTFChars(jquery, 0);
-  std::string query = std::string(q);
-  env->ReleaseStringUTFChars(jquery, q);
+namespace {
+// creates new UastIter over the results of a query on a managed node
+jobject filterUastIter(JNIEnv *env, jobject self, jobject jnode,
+                       const std::string &query) {
+  Context *ctx = liveHandle<Context>(env, self, ids.ctxNative, "Context");
+  if (!ctx) return nullptr;
 
   uast::Iterator<Node *> *it = nullptr;
   try {
     it = ctx->Filter(jnode, query);
   } catch (const std::exception &e) {
-    ThrowByName(env, CLS_RE, e.what());
+    ThrowRuntime(env, e.what());
     return nullptr;
   }
 
-  // new UastIter()
-  jobject iter =
-      NewJavaObject(env, CLS_JITER, METHOD_JITER_INIT, 0, 0, it, self);
+  // new UastIter(null, 0, it, self)
+  jobject iter = NewJavaObject(env, ids.clsJIter, ids.jiterInit, "UastIter",
+                               (jobject) nullptr, 0,
+                               reinterpret_cast<jlong>(it), self);
   if (env->ExceptionCheck() || !iter) {
     delete (it);
-    checkJvmException("failed create new UastIter class");
+    checkJvmException(env, "failed create new UastIter class");
+  } else if (it) {
+    stats.iterators++;
   }
   return iter;
 }
+}  // namespace
+
+JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_Context_filter(
+    JNIEnv *env, jobject self, jstring jquery, jobject jnode) {
+  const std::string &query = ScratchString(env, jquery);
+
+  return filterUastIter(env, self, jnode, query);
+}
+
+JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_Context_filterValues(
+    JNIEnv *env, jobject self, jobject jnode, jstring jquery, jint kind) {
+  Context *ctx = liveHandle<Context>(env, self, ids.ctxNative, "Context");
+  if (!ctx) return nullptr;
+
+  const std::string &query = ScratchString(env, jquery);
+
+  Values values((NodeKind)kind);
+  try {
+    std::unique_ptr<uast::Iterator<Node *>> it(ctx->Filter(jnode, query));
+    while (it->next() && !env->ExceptionCheck()) {
+      values.Add(it->node());
+    }
+  } catch (const std::exception &e) {
+    ThrowRuntime(env, e.what());
+    return nullptr;
+  }
+  if (env->ExceptionCheck()) return nullptr;
+  return values.ToJava(env);
+}
 
-JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_Context_nativeEncode(
+JNIEXPORT jbyteArray JNICALL Java_org_bblfsh_client_v2_Context_nativeEncode(
     JNIEnv *env, jobject self, jobject jnode, jint fmt) {
   UastFormat format = (UastFormat) fmt;
 
-  Context *p = getHandle<Context>(env, self, nativeContext);
+  Context *p = liveHandle<Context>(env, self, ids.ctxNative, "Context");
+  if (!p) return nullptr;
   return p->Encode(jnode, format);
 }
 
@@ -877,13 +2004,31 @@ Java_org_bblfsh_client_v2_Context_00024_create(JNIEnv *env, jobject self) {
   return reinterpret_cast<jlong>(c);
 }
 
+JNIEXPORT jlong JNICALL Java_org_bblfsh_client_v2_Context_arenaBytes(
+    JNIEnv *env, jobject self) {
+  Context *p = getHandle<Context>(env, self, ids.ctxNative, "Context.nativeContext");
+  return p ? p->ArenaBytes() : 0;
+}
+
+JNIEXPORT jlong JNICALL
+Java_org_bblfsh_client_v2_Context_00024_arenaPeakBytes(JNIEnv *env,
+                                                      jobject self) {
+  return arenaPeakBytes;
+}
+
+JNIEXPORT jlong JNICALL
+Java_org_bblfsh_client_v2_Context_00024_arenaTotalBytes(JNIEnv *env,
+                                                       jobject self) {
+  return arenaBytes;
+}
+
 JNIEXPORT void JNICALL Java_org_bblfsh_client_v2_Context_dispose(JNIEnv *env,
                                                                  jobject self) {
-  Context *p = getHandle<Context>(env, self, nativeContext);
+  Context *p = getHandle<Context>(env, self, ids.ctxNative, "Context.nativeContext");
 
   if (p) {
     delete p;
-    setHandle<Context>(env, self, 0, nativeContext);
+    setHandle<Context>(env, self, 0, ids.ctxNative, "Context.nativeContext");
   }
 };
 
@@ -893,30 +2038,152 @@ JNIEXPORT void JNICALL Java_org_bblfsh_client_v2_Context_dispose(JNIEnv *env,
 
 JNIEXPORT jobject JNICALL
 Java_org_bblfsh_client_v2_ContextExt_root(JNIEnv *env, jobject self) {
-  ContextExt *p = getHandle<ContextExt>(env, self, nativeContext);
+  ContextExt *p =
+      liveHandle<ContextExt>(env, self, ids.ctxExtNative, "ContextExt");
+  if (!p) return nullptr;
   return p->RootNode();
 }
 
 JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_ContextExt_filter(
     JNIEnv *env, jobject self, jstring jquery) {
-  ContextExt *ctx = getHandle<ContextExt>(env, self, nativeContext);
+  ContextExt *ctx =
+      liveHandle<ContextExt>(env, self, ids.ctxExtNative, "ContextExt");
+  if (!ctx) return nullptr;
   return filterUastIterExt(ctx, self, jquery, env);
 }
 
-JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_ContextExt_nativeEncode(
+JNIEXPORT jlong JNICALL Java_org_bblfsh_client_v2_ContextExt_count(
+    JNIEnv *env, jobject self, jstring jquery) {
+  ContextExt *ctx =
+      liveHandle<ContextExt>(env, self, ids.ctxExtNative, "ContextExt");
+  if (!ctx) return 0;
+
+  const std::string &query = ScratchString(env, jquery);
+
+  try {
+    return ctx->Count(nullptr, query);
+  } catch (const std::exception &e) {
+    ThrowRuntime(env, e.what());
+    return 0;
+  }
+}
+
+JNIEXPORT jboolean JNICALL Java_org_bblfsh_client_v2_ContextExt_exists(
+    JNIEnv *env, jobject self, jstring jquery) {
+  ContextExt *ctx =
+      liveHandle<ContextExt>(env, self, ids.ctxExtNative, "ContextExt");
+  if (!ctx) return false;
+
+  const std::string &query = ScratchString(env, jquery);
+
+  try {
+    return ctx->Exists(nullptr, query);
+  } catch (const std::exception &e) {
+    ThrowRuntime(env, e.what());
+    return false;
+  }
+}
+
+JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_ContextExt_filterValues(
+    JNIEnv *env, jobject self, jobject node, jstring jquery, jint kind) {
+  ContextExt *ctx =
+      liveHandle<ContextExt>(env, self, ids.ctxExtNative, "ContextExt");
+  if (!ctx) return nullptr;
+
+  const std::string &query = ScratchString(env, jquery);
+
+  // results are read one at a time without keeping their subtrees,
+  // no JVM objects are created for them
+  ScalarReader reader;
+  Values values((NodeKind)kind);
+  try {
+    std::unique_ptr<uast::Iterator<NodeHandle>> it(ctx->Filter(node, query));
+    while (it->next()) {
+      NodeHandle h = it->node();
+      if (h == 0) break;
+      values.Add(reader.Read(ctx, h));
+    }
+  } catch (const std::exception &e) {
+    ThrowRuntime(env, e.what());
+    return nullptr;
+  }
+  if (env->ExceptionCheck()) return nullptr;
+  return values.ToJava(env);
+}
+
+namespace {
+// Evaluates the queries in a single pass over the JNI boundary and converts
+// the results to long[][], one array of handles per query.
+jobjectArray filterMany(JNIEnv *env, jobject self, jobject node,
+                        const std::vector<std::string> &queries) {
+  ContextExt *ctx =
+      liveHandle<ContextExt>(env, self, ids.ctxExtNative, "ContextExt");
+  if (!ctx) return nullptr;
+
+  std::vector<std::vector<jlong>> results;
+  try {
+    results = ctx->FilterMany(node, queries);
+  } catch (const std::exception &e) {
+    ThrowRuntime(env, e.what());
+    return nullptr;
+  }
+  if (env->ExceptionCheck()) return nullptr;
+
+  jobjectArray out = env->NewObjectArray(results.size(), ids.clsLongArr, nullptr);
+  if (!out) return nullptr;
+  for (size_t i = 0; i < results.size(); i++) {
+    jlongArray arr = env->NewLongArray(results[i].size());
+    if (!arr) return nullptr;
+    env->SetLongArrayRegion(arr, 0, results[i].size(), results[i].data());
+    env->SetObjectArrayElement(out, i, arr);
+    env->DeleteLocalRef(arr);
+  }
+  return out;
+}
+}  // namespace
+
+JNIEXPORT jobjectArray JNICALL Java_org_bblfsh_client_v2_ContextExt_filterMany(
+    JNIEnv *env, jobject self, jobject node, jobjectArray jqueries) {
+  jsize n = env->GetArrayLength(jqueries);
+  std::vector<std::string> queries;
+  queries.reserve(n);
+  for (jsize i = 0; i < n; i++) {
+    jstring jquery = (jstring)env->GetObjectArrayElement(jqueries, i);
+    if (!jquery) {
+      ThrowRuntime(env, "query must not be null");
+      return nullptr;
+    }
+    queries.push_back(ScratchString(env, jquery));
+    env->DeleteLocalRef(jquery);
+  }
+  return filterMany(env, self, node, queries);
+}
+
+JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_ContextExt_filterHandles(
+    JNIEnv *env, jobject self, jstring jquery) {
+  ContextExt *ctx =
+      liveHandle<ContextExt>(env, self, ids.ctxExtNative, "ContextExt");
+  if (!ctx) return nullptr;
+  return filterIterExt(ctx, self, jquery, ids.clsHandleIter,
+                       ids.handleIterInit, env);
+}
+
+JNIEXPORT jbyteArray JNICALL Java_org_bblfsh_client_v2_ContextExt_nativeEncode(
     JNIEnv *env, jobject self, jobject node, jint fmt) {
   UastFormat format = (UastFormat) fmt;
 
-  ContextExt *p = getHandle<ContextExt>(env, self, nativeContext);
+  ContextExt *p =
+      liveHandle<ContextExt>(env, self, ids.ctxExtNative, "ContextExt");
+  if (!p) return nullptr;
   return p->Encode(node, format);
 }
 
 JNIEXPORT void JNICALL
 Java_org_bblfsh_client_v2_ContextExt_dispose(JNIEnv *env, jobject self) {
-  ContextExt *p = getHandle<ContextExt>(env, self, nativeContext);
+  ContextExt *p = getHandle<ContextExt>(env, self, ids.ctxExtNative, "ContextExt.nativeContext");
   if (p) {
     delete p;
-    setHandle<ContextExt>(env, self, 0, nativeContext);
+    setHandle<ContextExt>(env, self, 0, ids.ctxExtNative, "ContextExt.nativeContext");
   }
 }
 
@@ -938,13 +2205,363 @@ JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_NodeExt_load(JNIEnv *env,
   return result;
 }
 
+JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_NodeExt_loadBuffer(
+    JNIEnv *env, jobject self) {
+  NativeTree tree;
+  FlatWriter out;
+  try {
+    if (!tree.LoadFrom(env, self)) return nullptr;
+    out.Write(tree.Root());
+  } catch (const std::exception &e) {
+    ThrowRuntime(env, e.what());
+    return nullptr;
+  }
+  return out.NewDirectBuffer(env);
+}
+
 JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_NodeExt_filter(
     JNIEnv *env, jobject self, jstring jquery) {
-  jobject jCtxExt = ObjectField(env, self, "ctx", FIELD_CTX_EXT);
-  ContextExt *ctx = getHandle<ContextExt>(env, jCtxExt, nativeContext);
+  jobject jCtxExt = ObjectField(env, self, ids.nodeCtx, "NodeExt.ctx");
+  ContextExt *ctx =
+      liveHandle<ContextExt>(env, jCtxExt, ids.ctxExtNative, "ContextExt");
+  if (!ctx) return nullptr;
   return filterUastIterExt(ctx, jCtxExt, jquery, env);
 }
 
+// ==========================================
+//              v2.FlatJNode
+// ==========================================
+
+JNIEXPORT jbyteArray JNICALL Java_org_bblfsh_client_v2_FlatJNode_00024_encode(
+    JNIEnv *env, jobject self, jobject directBuf, jint fmt) {
+  UastFormat format = (UastFormat) fmt;
+
+  // works only with ByteBuffer.allocateDirect()
+  void *buf = env->GetDirectBufferAddress(directBuf);
+  jlong len = env->GetDirectBufferCapacity(directBuf);
+  if (!buf || len < 0) {
+    ThrowRuntime(env, "flat UAST must be in a direct buffer");
+    return nullptr;
+  }
+
+  try {
+    NativeTree tree;
+    tree.LoadFlat(static_cast<const char *>(buf), size_t(len));
+    return asJvmArray(tree.Encode(format));
+  } catch (const std::exception &e) {
+    ThrowRuntime(env, e.what());
+    return nullptr;
+  }
+}
+
+// ==========================================
+//              v2.TreeCursor()
+// ==========================================
+
+namespace {
+// Casts a cursor node handle back to a native node.
+// Throws to JVM if the cursor, and so the node, was already disposed.
+NativeNode *cursorNode(JNIEnv *env, jobject self, jlong node) {
+  if (!liveHandle<NativeTree>(env, self, ids.cursorNative, "TreeCursor")) {
+    return nullptr;
+  }
+  return reinterpret_cast<NativeNode *>(node);
+}
+}  // namespace
+
+JNIEXPORT jlong JNICALL Java_org_bblfsh_client_v2_TreeCursor_00024_create(
+    JNIEnv *env, jobject self, jobject nodeExt) {
+  NativeTree *tree = new NativeTree();
+  try {
+    if (!tree->LoadFrom(env, nodeExt)) {
+      delete tree;
+      return 0;
+    }
+  } catch (const std::exception &e) {
+    delete tree;
+    ThrowRuntime(env, e.what());
+    return 0;
+  }
+  return reinterpret_cast<jlong>(tree);
+}
+
+JNIEXPORT jlong JNICALL Java_org_bblfsh_client_v2_TreeCursor_root(JNIEnv *env,
+                                                                  jobject self) {
+  NativeTree *tree =
+      liveHandle<NativeTree>(env, self, ids.cursorNative, "TreeCursor");
+  if (!tree) return 0;
+  return reinterpret_cast<jlong>(tree->Root());
+}
+
+JNIEXPORT jint JNICALL Java_org_bblfsh_client_v2_TreeCursor_kind(
+    JNIEnv *env, jobject self, jlong node) {
+  NativeNode *n = cursorNode(env, self, node);
+  return n ? n->Kind() : NODE_NULL;
+}
+
+JNIEXPORT jint JNICALL Java_org_bblfsh_client_v2_TreeCursor_size(
+    JNIEnv *env, jobject self, jlong node) {
+  NativeNode *n = cursorNode(env, self, node);
+  return n ? n->Size() : 0;
+}
+
+JNIEXPORT jstring JNICALL Java_org_bblfsh_client_v2_TreeCursor_keyAt(
+    JNIEnv *env, jobject self, jlong node, jint i) {
+  NativeNode *n = cursorNode(env, self, node);
+  const std::string *key = n && i >= 0 ? n->Key(i) : nullptr;
+  if (!key) return nullptr;
+  return env->NewStringUTF(key->c_str());
+}
+
+JNIEXPORT jlong JNICALL Java_org_bblfsh_client_v2_TreeCursor_valueAt(
+    JNIEnv *env, jobject self, jlong node, jint i) {
+  NativeNode *n = cursorNode(env, self, node);
+  if (!n || i < 0) return 0;
+  return reinterpret_cast<jlong>(n->ValueAt(i));
+}
+
+JNIEXPORT jlong JNICALL Java_org_bblfsh_client_v2_TreeCursor_get(
+    JNIEnv *env, jobject self, jlong node, jstring jkey) {
+  NativeNode *n = cursorNode(env, self, node);
+  if (!n || !jkey) return 0;
+
+  NativeNode *val = n->Get(ScratchString(env, jkey));
+  return reinterpret_cast<jlong>(val);
+}
+
+JNIEXPORT jlong JNICALL Java_org_bblfsh_client_v2_TreeCursor_asInt(
+    JNIEnv *env, jobject self, jlong node) {
+  NativeNode *n = cursorNode(env, self, node);
+  return n ? n->AsInt() : 0;
+}
+
+JNIEXPORT jlong JNICALL Java_org_bblfsh_client_v2_TreeCursor_asUint(
+    JNIEnv *env, jobject self, jlong node) {
+  NativeNode *n = cursorNode(env, self, node);
+  return n ? n->AsUint() : 0;
+}
+
+JNIEXPORT jdouble JNICALL Java_org_bblfsh_client_v2_TreeCursor_asFloat(
+    JNIEnv *env, jobject self, jlong node) {
+  NativeNode *n = cursorNode(env, self, node);
+  return n ? n->AsFloat() : 0;
+}
+
+JNIEXPORT jboolean JNICALL Java_org_bblfsh_client_v2_TreeCursor_asBool(
+    JNIEnv *env, jobject self, jlong node) {
+  NativeNode *n = cursorNode(env, self, node);
+  return n && n->AsBool();
+}
+
+JNIEXPORT jstring JNICALL Java_org_bblfsh_client_v2_TreeCursor_asString(
+    JNIEnv *env, jobject self, jlong node) {
+  NativeNode *n = cursorNode(env, self, node);
+  if (!n || n->Kind() != NODE_STRING) return nullptr;
+  return env->NewStringUTF(n->Str().c_str());
+}
+
+JNIEXPORT jlong JNICALL Java_org_bblfsh_client_v2_TreeCursor_00024_fromBuffer(
+    JNIEnv *env, jobject self, jobject directBuf) {
+  // works only with ByteBuffer.allocateDirect()
+  void *buf = env->GetDirectBufferAddress(directBuf);
+  jlong len = env->GetDirectBufferCapacity(directBuf);
+  if (!buf || len < 0) {
+    ThrowRuntime(env, "flat UAST must be in a direct buffer");
+    return 0;
+  }
+
+  NativeTree *tree = new NativeTree();
+  try {
+    tree->LoadFlat(static_cast<const char *>(buf), size_t(len));
+  } catch (const std::exception &e) {
+    delete tree;
+    ThrowRuntime(env, e.what());
+    return 0;
+  }
+  return reinterpret_cast<jlong>(tree);
+}
+
+JNIEXPORT jlongArray JNICALL Java_org_bblfsh_client_v2_TreeCursor_filterNodes(
+    JNIEnv *env, jobject self, jstring jquery) {
+  NativeTree *tree = getHandle<NativeTree>(env, self, ids.cursorNative, "TreeCursor.nativeCursor");
+  if (!tree) {
+    ThrowRuntime(env, "TreeCursor was already disposed");
+    return nullptr;
+  }
+
+  const std::string &query = ScratchString(env, jquery);
+
+  // pairs of the preorder index (or -1) and the handle of each result
+  std::vector<jlong> results;
+  try {
+    std::unique_ptr<uast::Iterator<NativeNode *>> it(tree->Filter(query));
+    while (it->next()) {
+      NativeNode *node = it->node();
+      results.push_back(node ? node->Index() : -1);
+      results.push_back(reinterpret_cast<jlong>(node));
+    }
+  } catch (const std::exception &e) {
+    ThrowRuntime(env, e.what());
+    return nullptr;
+  }
+
+  jlongArray arr = env->NewLongArray(results.size());
+  if (arr) env->SetLongArrayRegion(arr, 0, results.size(), results.data());
+  return arr;
+}
+
+JNIEXPORT void JNICALL Java_org_bblfsh_client_v2_TreeCursor_dispose(
+    JNIEnv *env, jobject self) {
+  NativeTree *tree = getHandle<NativeTree>(env, self, ids.cursorNative, "TreeCursor.nativeCursor");
+  if (tree) {
+    delete tree;
+    setHandle<NativeTree>(env, self, 0, ids.cursorNative, "TreeCursor.nativeCursor");
+  }
+}
+
+// ==========================================
+//              v2.UastArchive()
+// ==========================================
+
+namespace {
+// Finds the entry of a UTF-8 encoded key of the archive.
+// Throws to JVM and returns nullptr if the archive was disposed.
+const UastArchive::Entry *findEntry(JNIEnv *env, jobject self, jbyteArray jkey,
+                                    UastArchive **archive) {
+  *archive = getHandle<UastArchive>(env, self, ids.archiveNative, "UastArchive.nativeArchive");
+  if (!*archive) {
+    ThrowRuntime(env, "UastArchive was already disposed");
+    return nullptr;
+  }
+  if (!jkey) return nullptr;
+
+  static thread_local std::string key;
+  key.resize(env->GetArrayLength(jkey));
+  if (!key.empty()) {
+    env->GetByteArrayRegion(jkey, 0, (jsize)key.size(), (jbyte *)&key[0]);
+  }
+  return (*archive)->Find(key);
+}
+
+jbyteArray newByteArray(JNIEnv *env, const char *data, size_t size) {
+  jbyteArray arr = env->NewByteArray((jsize)size);
+  if (!arr) return nullptr;
+  env->SetByteArrayRegion(arr, 0, (jsize)size, (const jbyte *)data);
+  return arr;
+}
+}  // namespace
+
+JNIEXPORT jlong JNICALL Java_org_bblfsh_client_v2_UastArchive_00024_open(
+    JNIEnv *env, jobject self, jstring jpath) {
+  if (!jpath) {
+    ThrowRuntime(env, "cannot open a null path");
+    return 0;
+  }
+  try {
+    return reinterpret_cast<jlong>(UastArchive::Open(ScratchString(env, jpath)));
+  } catch (const std::exception &e) {
+    ThrowRuntime(env, e.what());
+  }
+  return 0;
+}
+
+JNIEXPORT jint JNICALL Java_org_bblfsh_client_v2_UastArchive_size(JNIEnv *env,
+                                                                  jobject self) {
+  UastArchive *a = getHandle<UastArchive>(env, self, ids.archiveNative, "UastArchive.nativeArchive");
+  return a ? (jint)a->Size() : 0;
+}
+
+JNIEXPORT jbyteArray JNICALL Java_org_bblfsh_client_v2_UastArchive_keyBytes(
+    JNIEnv *env, jobject self, jint i) {
+  UastArchive *a = getHandle<UastArchive>(env, self, ids.archiveNative, "UastArchive.nativeArchive");
+  if (!a || i < 0 || (size_t)i >= a->Size()) return nullptr;
+
+  const std::string &key = a->At(i).key;
+  return newByteArray(env, key.data(), key.size());
+}
+
+JNIEXPORT jboolean JNICALL Java_org_bblfsh_client_v2_UastArchive_containsKey(
+    JNIEnv *env, jobject self, jbyteArray jkey) {
+  UastArchive *a;
+  return findEntry(env, self, jkey, &a) != nullptr;
+}
+
+JNIEXPORT jbyteArray JNICALL Java_org_bblfsh_client_v2_UastArchive_metadataOf(
+    JNIEnv *env, jobject self, jbyteArray jkey) {
+  UastArchive *a;
+  const UastArchive::Entry *e = findEntry(env, self, jkey, &a);
+  if (!e) return nullptr;
+  return newByteArray(env, a->Metadata(*e), e->metaLength);
+}
+
+JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_UastArchive_decodeEntry(
+    JNIEnv *env, jobject self, jbyteArray jkey, jint fmt) {
+  UastArchive *a;
+  const UastArchive::Entry *entry = findEntry(env, self, jkey, &a);
+  if (!entry) {
+    if (a) ThrowRuntime(env, "no such entry in the UAST archive");
+    return nullptr;
+  }
+
+  try {
+    // decoded from the mapped entry, the context shares the mapping and
+    // outlives the archive if needed
+    uast::Buffer ubuf(const_cast<char *>(a->Data(*entry)), (size_t)entry->length);
+    uast::Context<NodeHandle> *ctx = uast::Decode(ubuf, (UastFormat)fmt);
+    return newContextExt(env, ctx, ubuf.size, a->File());
+  } catch (const std::exception &e) {
+    ThrowRuntime(env, e.what());
+  }
+  return nullptr;
+}
+
+JNIEXPORT void JNICALL Java_org_bblfsh_client_v2_UastArchive_dispose(
+    JNIEnv *env, jobject self) {
+  UastArchive *a = getHandle<UastArchive>(env, self, ids.archiveNative, "UastArchive.nativeArchive");
+  if (a) {
+    delete a;
+    setHandle<UastArchive>(env, self, 0, ids.archiveNative, "UastArchive.nativeArchive");
+  }
+}
+
+// ==========================================
+//                Node Kinds
+// ==========================================
+
+// Exposes node kinds from the libuast to Scala
+JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_getNodeKinds(JNIEnv *env,
+                                                                                 jobject self) {
+    jobject jObj = NewJavaObject(env, ids.clsNodeKind, ids.nodeKindInit, "NodeKind",
+                                 NODE_NULL,
+                                 NODE_OBJECT,
+                                 NODE_ARRAY,
+                                 NODE_STRING,
+                                 NODE_INT,
+                                 NODE_UINT,
+                                 NODE_FLOAT,
+                                 NODE_BOOL);
+    return jObj;
+}
+
+JNIEXPORT jlong JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_allocations(JNIEnv *env,
+                                                                              jobject self) {
+    return NativeAllocations();
+}
+
+// Snapshot of the NativeStats counters, in the order of their fields
+JNIEXPORT jlongArray JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_stats(JNIEnv *env,
+                                                                             jobject self) {
+    const jlong values[] = {
+        stats.contextsExt,  stats.contexts,    stats.iterators,
+        stats.nodes,        stats.refsCreated, stats.refsDeleted,
+        stats.decodedBytes, stats.encodedBytes,
+    };
+    const jsize n = sizeof(values) / sizeof(values[0]);
+    jlongArray arr = env->NewLongArray(n);
+    if (!arr) return nullptr;
+    env->SetLongArrayRegion(arr, 0, n, values);
+    return arr;
+}
 
 // ==========================================
 //                Tree Orders
@@ -953,7 +2570,7 @@ JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_NodeExt_filter(
 // Exposes tree orders from the libuast to Scala
 JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_getTreeOrders(JNIEnv *env,
                                                                                   jobject self) {
-    jobject jObj = NewJavaObject(env, CLS_TO, "(IIIIII)V",
+    jobject jObj = NewJavaObject(env, ids.clsTreeOrder, ids.treeOrderInit, "TreeOrder",
                                  ANY_ORDER,
                                  PRE_ORDER,
                                  POST_ORDER,
@@ -968,7 +2585,7 @@ JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_getTreeOrder
 // ==========================================
 JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_getUastFormats(JNIEnv *env,
                                                                                    jobject self) {
-    jobject jObj = NewJavaObject(env, CLS_ENCS, "(II)V",
+    jobject jObj = NewJavaObject(env, ids.clsUastFormat, ids.uastFormatInit, "UastFormat",
                                  UAST_BINARY,
                                  UAST_YAML);
     return jObj;
@@ -982,39 +2599,18 @@ JNIEXPORT jint JNI_OnLoad(JavaVM *vm, void *reserved) {
   }
   jvm = vm;
 
-  jclass localRE = env->FindClass(CLS_RE);
-
-  if (env->ExceptionCheck() || !localRE) {
-    env->ExceptionClear();
-    env->Throw(env->ExceptionOccurred());
+  if (!ResolveIds(env)) {
     return JNI_ERR;
   }
 
-  // Set exceptionCls also in the cache
-  exceptionCls = (jclass) env->NewGlobalRef(localRE);
-  // Set exceptionCls also in the cache
-  classCache[CLS_RE] = exceptionCls;
-  env->DeleteLocalRef(localRE);
-
-  exceptToString = env->GetMethodID(exceptionCls, "toString", METHOD_OBJ_TO_STR);
-
-  if (env->ExceptionCheck() || !exceptToString) {
-    env->ExceptionClear();
-    env->ThrowNew(exceptionCls, "failed to find method toString");
-    return JNI_ERR;
-  }
-
-  // Set exceptionCls->toString also in the cache
-  methodCache[CLS_RE]["toString"][METHOD_OBJ_TO_STR] = exceptToString;
-
   return JNI_VERSION_1_8;
 }
 
-void JNI_OnUnLoad(JavaVM *vm, void *reserved) {
+JNIEXPORT void JNI_OnUnload(JavaVM *vm, void *reserved) {
   JNIEnv *env = getJNIEnv();
 
   if (env) {
-    env->DeleteGlobalRef(exceptionCls);
-    clearClassCache(env);
+    jstrings.Clear(env);
+    ReleaseIds(env);
   }
 }
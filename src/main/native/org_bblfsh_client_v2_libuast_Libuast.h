@@ -31,6 +31,54 @@ JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_getTreeOrder
 JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_getUastFormats
   (JNIEnv *, jobject);
 
+/*
+ * Class:     org_bblfsh_client_v2_libuast_Libuast
+ * Method:    getNodeKinds
+ * Signature: ()Lorg/bblfsh/client/v2/libuast/Libuast/NodeKind;
+ */
+JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_getNodeKinds
+  (JNIEnv *, jobject);
+
+/*
+ * Class:     org_bblfsh_client_v2_libuast_Libuast
+ * Method:    allocations
+ * Signature: ()J
+ */
+JNIEXPORT jlong JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_allocations
+  (JNIEnv *, jobject);
+
+/*
+ * Class:     org_bblfsh_client_v2_libuast_Libuast
+ * Method:    decodeBytes
+ * Signature: ([BIII)Lorg/bblfsh/client/v2/ContextExt;
+ */
+JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_decodeBytes
+  (JNIEnv *, jobject, jbyteArray, jint, jint, jint);
+
+/*
+ * Class:     org_bblfsh_client_v2_libuast_Libuast
+ * Method:    decodeFile
+ * Signature: (Ljava/lang/String;I)Lorg/bblfsh/client/v2/ContextExt;
+ */
+JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_decodeFile
+  (JNIEnv *, jobject, jstring, jint);
+
+/*
+ * Class:     org_bblfsh_client_v2_libuast_Libuast
+ * Method:    countBatch
+ * Signature: ([Ljava/nio/ByteBuffer;[Ljava/lang/String;II)[J
+ */
+JNIEXPORT jlongArray JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_countBatch
+  (JNIEnv *, jobject, jobjectArray, jobjectArray, jint, jint);
+
+/*
+ * Class:     org_bblfsh_client_v2_libuast_Libuast
+ * Method:    stats
+ * Signature: ()[J
+ */
+JNIEXPORT jlongArray JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_stats
+  (JNIEnv *, jobject);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,37 @@
+/* DO NOT EDIT THIS FILE - it is machine generated */
+#include <jni.h>
+/* Header for class org_bblfsh_client_v2_libuast_Libuast_UastHandleIter */
+
+#ifndef _Included_org_bblfsh_client_v2_libuast_Libuast_UastHandleIter
+#define _Included_org_bblfsh_client_v2_libuast_Libuast_UastHandleIter
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     org_bblfsh_client_v2_libuast_Libuast_UastHandleIter
+ * Method:    nativeNextHandles
+ * Signature: (J[J)I
+ */
+JNIEXPORT jint JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_00024UastHandleIter_nativeNextHandles
+  (JNIEnv *, jobject, jlong, jlongArray);
+
+/*
+ * Class:     org_bblfsh_client_v2_libuast_Libuast_UastHandleIter
+ * Method:    nativeInit
+ * Signature: ()V
+ */
+JNIEXPORT void JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_00024UastHandleIter_nativeInit
+  (JNIEnv *, jobject);
+
+/*
+ * Class:     org_bblfsh_client_v2_libuast_Libuast_UastHandleIter
+ * Method:    nativeDispose
+ * Signature: ()V
+ */
+JNIEXPORT void JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_00024UastHandleIter_nativeDispose
+  (JNIEnv *, jobject);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
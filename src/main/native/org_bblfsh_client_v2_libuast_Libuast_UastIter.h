@@ -15,6 +15,14 @@ extern "C" {
 JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_00024UastIter_nativeNext
   (JNIEnv *, jobject, jlong);
 
+/*
+ * Class:     org_bblfsh_client_v2_libuast_Libuast_UastIter
+ * Method:    nativeNextBatch
+ * Signature: (JI)[Lorg/bblfsh/client/v2/JNode;
+ */
+JNIEXPORT jobjectArray JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_00024UastIter_nativeNextBatch
+  (JNIEnv *, jobject, jlong, jint);
+
 /*
  * Class:     org_bblfsh_client_v2_libuast_Libuast_UastIter
  * Method:    nativeInit
@@ -15,6 +15,14 @@ extern "C" {
 JNIEXPORT jobject JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_00024UastIterExt_nativeNext
   (JNIEnv *, jobject, jlong);
 
+/*
+ * Class:     org_bblfsh_client_v2_libuast_Libuast_UastIterExt
+ * Method:    nativeNextBatch
+ * Signature: (JI)[Lorg/bblfsh/client/v2/NodeExt;
+ */
+JNIEXPORT jobjectArray JNICALL Java_org_bblfsh_client_v2_libuast_Libuast_00024UastIterExt_nativeNextBatch
+  (JNIEnv *, jobject, jlong, jint);
+
 /*
  * Class:     org_bblfsh_client_v2_libuast_Libuast_UastIterExt
  * Method:    nativeInit
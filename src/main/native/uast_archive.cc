@@ -0,0 +1,106 @@
+#include "uast_archive.h"
+
+#include <cstring>
+#include <stdexcept>
+
+const char UastArchive::Magic[4] = {'B', 'U', 'A', 'R'};
+const uint32_t UastArchive::Version;
+const size_t UastArchive::HeaderSize;
+const size_t UastArchive::FooterSize;
+
+namespace {
+// Bounds-checked little-endian reader over a part of the archive.
+class Reader {
+ public:
+  Reader(const char *d, size_t s, size_t p) : data(d), size(s), pos(p) {}
+
+  uint32_t U32() { return (uint32_t)Uint(4); }
+  uint64_t U64() { return Uint(8); }
+
+  std::string Bytes(size_t n) {
+    need(n);
+    std::string s(data + pos, n);
+    pos += n;
+    return s;
+  }
+
+  size_t Pos() const { return pos; }
+
+ private:
+  const char *data;
+  size_t size;
+  size_t pos;
+
+  void need(size_t n) {
+    if (n > size - pos) {
+      throw std::runtime_error("malformed UAST archive: truncated index");
+    }
+  }
+
+  uint64_t Uint(size_t n) {
+    need(n);
+    uint64_t v = 0;
+    for (size_t i = 0; i < n; i++) {
+      v |= (uint64_t)(uint8_t)data[pos + i] << (8 * i);
+    }
+    pos += n;
+    return v;
+  }
+};
+
+void checkRange(uint64_t off, uint64_t len, uint64_t end) {
+  if (off > end || len > end - off) {
+    throw std::runtime_error("malformed UAST archive: entry out of bounds");
+  }
+}
+}  // namespace
+
+UastArchive *UastArchive::Open(const std::string &path) {
+  auto file = MappedFile::Open(path);
+  const char *data = file->Data();
+  size_t size = file->Size();
+
+  if (size < HeaderSize + FooterSize || memcmp(data, Magic, 4) != 0 ||
+      memcmp(data + size - 4, Magic, 4) != 0) {
+    throw std::runtime_error(path + " is not a UAST archive");
+  }
+
+  Reader header(data, size, 4);
+  if (header.U32() != Version) {
+    throw std::runtime_error(path + " has an unsupported archive version");
+  }
+
+  Reader footer(data, size, size - FooterSize);
+  uint64_t indexOffset = footer.U64();
+  uint32_t count = footer.U32();
+  uint64_t indexEnd = size - FooterSize;
+  if (indexOffset < HeaderSize || indexOffset > indexEnd) {
+    throw std::runtime_error("malformed UAST archive: bad index offset");
+  }
+
+  std::unique_ptr<UastArchive> a(new UastArchive(file));
+  a->entries.reserve(count);
+  a->byKey.reserve(count);
+
+  Reader index(data, (size_t)indexEnd, (size_t)indexOffset);
+  for (uint32_t i = 0; i < count; i++) {
+    Entry e;
+    e.key = index.Bytes(index.U32());
+    e.offset = index.U64();
+    e.length = index.U64();
+    e.metaOffset = index.U64();
+    e.metaLength = index.U32();
+    checkRange(e.offset, e.length, indexOffset);
+    checkRange(e.metaOffset, e.metaLength, indexOffset);
+
+    a->byKey[e.key] = a->entries.size();
+    a->entries.push_back(std::move(e));
+  }
+  return a.release();
+}
+
+const UastArchive::Entry *UastArchive::Find(const std::string &key) const {
+  auto it = byKey.find(key);
+  if (it == byKey.end()) return nullptr;
+  return &entries[it->second];
+}
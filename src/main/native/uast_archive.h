@@ -0,0 +1,67 @@
+#ifndef _Included_org_bblfsh_client_libuast_Libuast_uast_archive
+#define _Included_org_bblfsh_client_libuast_Libuast_uast_archive
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mapped_file.h"
+
+// Reader of a UAST archive, written by UastArchive.Writer on the Scala side.
+//
+// Layout, all integers are little-endian:
+//
+//   header  "BUAR" uint32 version
+//   data    UAST blobs and their metadata, appended one after another
+//   index   per entry: uint32 key length, key bytes (UTF-8),
+//                      uint64 offset, uint64 length,
+//                      uint64 metadata offset, uint32 metadata length
+//   footer  uint64 index offset, uint32 entry count, "BUAR"
+//
+// The archive is memory-mapped and only the index is parsed on open.
+// Entries point into the mapping, that is shared with everything decoded
+// from it. If a key appears more than once, the last entry wins.
+class UastArchive {
+ public:
+  static const char Magic[4];
+  static const uint32_t Version = 1;
+  static const size_t HeaderSize = 8;
+  static const size_t FooterSize = 16;
+
+  struct Entry {
+    std::string key;
+    uint64_t offset;
+    uint64_t length;
+    uint64_t metaOffset;
+    uint32_t metaLength;
+  };
+
+  // Maps and indexes the archive at the given path.
+  // Throws std::runtime_error if it cannot be read or is malformed.
+  static UastArchive *Open(const std::string &path);
+
+  size_t Size() const { return entries.size(); }
+  const Entry &At(size_t i) const { return entries[i]; }
+
+  // Returns the entry of the key, or nullptr.
+  const Entry *Find(const std::string &key) const;
+
+  const char *Data(const Entry &e) const { return file->Data() + e.offset; }
+  const char *Metadata(const Entry &e) const {
+    return file->Data() + e.metaOffset;
+  }
+
+  const std::shared_ptr<MappedFile> &File() const { return file; }
+
+ private:
+  UastArchive(std::shared_ptr<MappedFile> f) : file(std::move(f)) {}
+
+  std::shared_ptr<MappedFile> file;
+  std::vector<Entry> entries;
+  std::unordered_map<std::string, size_t> byKey;
+};
+
+#endif
@@ -0,0 +1,71 @@
+package org.bblfsh.client.v2
+
+import java.nio.ByteBuffer
+
+import org.bblfsh.client.v2.libuast.Libuast
+
+/**
+  * Decodes and queries many encoded UASTs with a single JNI call.
+  *
+  * Buffers are decoded and queried on a pool of native threads with work
+  * stealing, each context is private to the thread that decoded it and
+  * no JVM objects are created for the nodes. Only the number of results of
+  * each query in each buffer is returned.
+  *
+  * {{{
+  * val counts = BatchFilter.count(buffers, Seq("//uast:Identifier"))
+  * counts(0, 0) // identifiers in the first buffer
+  * }}}
+  */
+object BatchFilter {
+  import BblfshClient.{UastFormat, UastBinary}
+
+  private val libuast = new Libuast
+
+  /**
+    * Number of results of each query in each buffer, stored by buffer
+    * and then by query. -1 for the buffers that could not be decoded.
+    */
+  case class Counts(queries: Int, counts: Array[Long]) {
+    def buffers: Int = if (queries == 0) 0 else counts.length / queries
+
+    def apply(buffer: Int, query: Int): Long = counts(buffer * queries + query)
+
+    /** Counts of all the queries in the given buffer */
+    def of(buffer: Int): Array[Long] =
+      counts.slice(buffer * queries, (buffer + 1) * queries)
+
+    def failed(buffer: Int): Boolean = queries > 0 && apply(buffer, 0) < 0
+  }
+
+  /**
+    * Decodes every buffer and counts the results of every query in it.
+    *
+    * Like BblfshClient.decode(), takes the whole capacity of each buffer.
+    * Heap buffers are copied to direct ones first.
+    *
+    * @param threads number of native threads, all the available cores if 0
+    */
+  def count(buffers: Seq[ByteBuffer], queries: Seq[String],
+            threads: Int, fmt: UastFormat): Counts = {
+    val direct = buffers.map { buf =>
+      if (buf.isDirect) {
+        buf
+      } else {
+        val copy = ByteBuffer.allocateDirect(buf.capacity())
+        val dup = buf.duplicate()
+        dup.clear()
+        copy.put(dup)
+        copy.flip()
+        copy
+      }
+    }.toArray
+    Counts(queries.size, libuast.countBatch(direct, queries.toArray, fmt.toInt, threads))
+  }
+
+  def count(buffers: Seq[ByteBuffer], queries: Seq[String], threads: Int): Counts =
+    count(buffers, queries, threads, UastBinary)
+
+  def count(buffers: Seq[ByteBuffer], queries: Seq[String]): Counts =
+    count(buffers, queries, 0, UastBinary)
+}
@@ -2,7 +2,7 @@ package org.bblfsh.client.v2
 
 import java.nio.ByteBuffer
 
-import com.google.protobuf.ByteString
+import com.google.protobuf.{ByteOutput, ByteString, UnsafeByteOperations}
 import gopkg.in.bblfsh.sdk.v2.protocol.driver._
 import io.grpc.ManagedChannelBuilder
 import java.util.concurrent.TimeUnit
@@ -114,9 +114,11 @@ object BblfshClient {
   private val libuast = new Libuast
   private val orders = libuast.getTreeOrders
   private val formats = libuast.getUastFormats
+  private val kinds = libuast.getNodeKinds
 
   abstract class UastFormat(val toInt: Int)
   abstract class TreeOrder(val toInt: Int)
+  abstract class NodeKind(val toInt: Int)
 
   // Lift tree order as constants
   case object UastBinary extends UastFormat(formats.uastBinary)
@@ -130,6 +132,16 @@ object BblfshClient {
   case object ChildrenOrder extends TreeOrder(orders.childrenOrder)
   case object PositionOrder extends TreeOrder(orders.positionOrder)
 
+  // Lift node kinds from libuast as types
+  case object NullKind extends NodeKind(kinds.nullKind)
+  case object ObjectKind extends NodeKind(kinds.objectKind)
+  case object ArrayKind extends NodeKind(kinds.arrayKind)
+  case object StringKind extends NodeKind(kinds.stringKind)
+  case object IntKind extends NodeKind(kinds.intKind)
+  case object UintKind extends NodeKind(kinds.uintKind)
+  case object FloatKind extends NodeKind(kinds.floatKind)
+  case object BoolKind extends NodeKind(kinds.boolKind)
+
   /** Creates a BblfshClient with default parameters */
   def apply(
     host: String, port: Int,
@@ -138,49 +150,140 @@ object BblfshClient {
 
   /**
     * Decodes bytes from wired format of bblfsh protocol.v2.
-    * Requires a buffer in Direct mode, and the format
-    * to decode from
+    * Takes the whole capacity of the buffer, and the format
+    * to decode from.
+    *
+    * Direct buffers are decoded in place and kept reachable by the context.
+    * Heap buffers with an accessible array are copied once to native memory
+    * held by the context, without pinning the array. Read-only heap buffers
+    * are copied to an array first.
+    *
+    * Safe to call concurrently from multiple threads.
     *
     * Since v2.
     */
-  def decode(buf: ByteBuffer, fmt: UastFormat): ContextExt = Libuast.synchronized {
-    if (!buf.isDirect()) {
-      throw new RuntimeException("Only directly-allocated buffer decoding is supported.")
+  def decode(buf: ByteBuffer, fmt: UastFormat): ContextExt = {
+    if (buf.isDirect()) {
+      libuast.decode(buf, fmt)
+    } else if (buf.hasArray()) {
+      libuast.decodeBytes(buf.array(), buf.arrayOffset(), buf.capacity(), fmt)
+    } else {
+      val bytes = new Array[Byte](buf.capacity())
+      val dup = buf.duplicate()
+      dup.clear()
+      dup.get(bytes)
+      decode(bytes, fmt)
     }
-    libuast.decode(buf, fmt)
   }
 
   /**
     * Decodes bytes from wired binary format of bblfsh protocol.v2.
-    * Requires a buffer in Direct mode
     *
     * Since v2.
     */
-  def decode(buf: ByteBuffer): ContextExt = Libuast.synchronized {
+  def decode(buf: ByteBuffer): ContextExt = {
     decode(buf, UastBinary)
   }
 
+  /**
+    * Decodes bytes from wired format of bblfsh protocol.v2.
+    *
+    * The array is copied once to native memory held by the context,
+    * without pinning it.
+    */
+  def decode(bytes: Array[Byte], fmt: UastFormat): ContextExt = {
+    libuast.decodeBytes(bytes, 0, bytes.length, fmt)
+  }
+
+  /** Decodes bytes from wired binary format of bblfsh protocol.v2 */
+  def decode(bytes: Array[Byte]): ContextExt = {
+    decode(bytes, UastBinary)
+  }
+
+  /**
+    * Decodes a file with UAST in wired format of bblfsh protocol.v2.
+    *
+    * The file is memory-mapped and decoded without reading it to the heap
+    * or copying it. The mapping is released when the context is disposed.
+    */
+  def decodeFile(path: String, fmt: UastFormat): ContextExt = {
+    libuast.decodeFile(path, fmt)
+  }
+
+  /** Decodes a file with UAST in binary format of bblfsh protocol.v2 */
+  def decodeFile(path: String): ContextExt = {
+    decodeFile(path, UastBinary)
+  }
+
+  /**
+    * Receives the content of a ByteString without copying it.
+    *
+    * Keeps the single chunk of a flat ByteString, as given to writeLazy().
+    * Content written in several chunks, or through write() that does not
+    * allow to keep a reference, is marked to be copied instead.
+    */
+  private class ChunkOutput extends ByteOutput {
+    var array: Array[Byte] = null
+    var offset = 0
+    var length = 0
+    var buffer: ByteBuffer = null
+    var copy = false
+
+    private def chunk(): Boolean = {
+      copy = copy || array != null || buffer != null
+      !copy
+    }
+
+    override def write(value: Byte): Unit = copy = true
+    override def write(value: Array[Byte], off: Int, len: Int): Unit = copy = true
+    override def write(value: ByteBuffer): Unit = copy = true
+
+    override def writeLazy(value: Array[Byte], off: Int, len: Int): Unit = {
+      if (chunk()) {
+        array = value
+        offset = off
+        length = len
+      }
+    }
+
+    override def writeLazy(value: ByteBuffer): Unit = {
+      if (chunk()) {
+        buffer = value.slice()
+      }
+    }
+  }
+
+  /**
+    * Decodes the content of a ByteString.
+    *
+    * Flat ByteStrings, like the ones in gRPC responses, are copied once from
+    * their own array to native memory held by the context, without pinning
+    * it, or decoded in place if they wrap a direct buffer. Other ones are
+    * copied to a heap array first.
+    */
+  def decode(bytes: ByteString, fmt: UastFormat): ContextExt = {
+    val out = new ChunkOutput
+    UnsafeByteOperations.unsafeWriteTo(bytes, out)
+    if (!out.copy && out.array != null) {
+      libuast.decodeBytes(out.array, out.offset, out.length, fmt)
+    } else if (!out.copy && out.buffer != null &&
+               (out.buffer.isDirect() || out.buffer.hasArray())) {
+      decode(out.buffer, fmt)
+    } else {
+      decode(bytes.toByteArray(), fmt)
+    }
+  }
+
   /** Enables API: resp.uast.decode() */
   implicit class UastMethods(val buf: ByteString) {
     /**
       * Decodes bytes from wire format of bblfsh protocol.v2.
       *
-      * Always copies memory to a new buffer in Direct mode,
-      * to be able to pass it to JNI.
+      * Decodes from the memory of the ByteString when possible,
+      * see BblfshClient.decode(ByteString, UastFormat).
       */
     def decode(fmt: UastFormat): ContextExt = {
-      val bufDirectCopy = ByteBuffer.allocateDirect(buf.size)
-      buf.copyTo(bufDirectCopy)
-      val result = BblfshClient.decode(bufDirectCopy, fmt)
-      // Sometimes the direct buffer can take a lot to deallocate,
-      // causing Out of Memory, because it is not allocated in
-      // in the JVM heap and will only be deallocated them when
-      // JVM does not have more space in its heap
-      // This line alleviates the problem
-      // Problem can be tested if we remove it and do a
-      // loop decoding a file
-      System.gc()
-      result
+      BblfshClient.decode(buf, fmt)
     }
 
     /**
@@ -218,6 +321,7 @@ object BblfshClient {
     def filterFloat(node: JNode, query: String) = BblfshClient.filterFloat(node, query)
     def iterator(node: NodeExt, treeOrder: TreeOrder) = BblfshClient.iterator(node, treeOrder)
     def iterator(node: JNode, treeOrder: TreeOrder) = BblfshClient.iterator(node, treeOrder)
+    def handleIterator(node: NodeExt, treeOrder: TreeOrder) = BblfshClient.handleIterator(node, treeOrder)
   }
 
   /** Factory method for iterator over an external/native node */
@@ -225,18 +329,52 @@ object BblfshClient {
     Libuast.UastIterExt(node, treeOrder)
   }
 
+  /**
+    * Factory method for iterator over an external/native node,
+    * fetching up to batchSize nodes per JNI call
+    */
+  def iterator(node: NodeExt, treeOrder: TreeOrder, batchSize: Int): Libuast.UastIterExt = {
+    Libuast.UastIterExt(node, treeOrder, batchSize)
+  }
+
+  /**
+    * Factory method for iterator over the handles of an external/native node.
+    * Does not allocate a NodeExt per node, see ContextExt.node(handle)
+    */
+  def handleIterator(node: NodeExt, treeOrder: TreeOrder): Libuast.UastHandleIter = {
+    Libuast.UastHandleIter(node, treeOrder)
+  }
+
   /** Factory method for iterator over a managed node */
   def iterator(node: JNode, treeOrder: TreeOrder): Libuast.UastIter = {
     Libuast.UastIter(node, treeOrder)
   }
 
-  /** Factory method for iterator over a native node, filtered by XPath query */
-  def filter(node: NodeExt, query: String): Libuast.UastIterExt = Libuast.synchronized {
+  /**
+    * Factory method for iterator over a managed node,
+    * fetching up to batchSize nodes per JNI call
+    */
+  def iterator(node: JNode, treeOrder: TreeOrder, batchSize: Int): Libuast.UastIter = {
+    Libuast.UastIter(node, treeOrder, batchSize)
+  }
+
+  /**
+    * Factory method for iterator over a native node, filtered by XPath query
+    *
+    * Filters over different contexts run in parallel. Only the creation of
+    * the iterator is serialized on the context, iterating it and any other
+    * use of the same context is not, see [[ContextExt]].
+    */
+  def filter(node: NodeExt, query: String): Libuast.UastIterExt = node.ctx.synchronized {
     node.filter(query)
   }
 
-  /** Factory method for iterator over a managed node, filtered by XPath query */
-  def filter(node: JNode, query: String): Libuast.UastIter = Libuast.synchronized {
+  /**
+    * Factory method for iterator over a managed node, filtered by XPath query
+    *
+    * Every call uses a new context, so it is safe to call concurrently.
+    */
+  def filter(node: JNode, query: String): Libuast.UastIter = {
     val ctx = Context()
     ctx.filter(query, node)
     // do not dispose the context, iterator steals it
@@ -262,4 +400,28 @@ object BblfshClient {
   def filterInt(node: JNode, query: String) = filterOnType[JInt](node, query)
   def filterUint(node: JNode, query: String) = filterOnType[JUint](node, query)
   def filterFloat(node: JNode, query: String) = filterOnType[JFloat](node, query)
+
+  /** Evaluates an XPath query natively and returns the values of the results
+    * of the given kind directly, without creating an iterator or JNode per result.
+    * Every call uses a new context, so it is safe to call concurrently.
+    */
+  private def filterValues(node: JNode, query: String, kind: NodeKind): AnyRef = {
+    val ctx = Context()
+    try {
+      ctx.filterValues(node, query, kind.toInt)
+    } finally {
+      ctx.dispose()
+    }
+  }
+
+  def filterInts(node: JNode, query: String): Array[Long] =
+    filterValues(node, query, IntKind).asInstanceOf[Array[Long]]
+  def filterUints(node: JNode, query: String): Array[Long] =
+    filterValues(node, query, UintKind).asInstanceOf[Array[Long]]
+  def filterFloats(node: JNode, query: String): Array[Double] =
+    filterValues(node, query, FloatKind).asInstanceOf[Array[Double]]
+  def filterBools(node: JNode, query: String): Array[Boolean] =
+    filterValues(node, query, BoolKind).asInstanceOf[Array[Boolean]]
+  def filterStrings(node: JNode, query: String): Array[String] =
+    FlatJNode.readStrings(filterValues(node, query, StringKind).asInstanceOf[ByteBuffer])
 }
@@ -2,22 +2,75 @@ package org.bblfsh.client.v2
 
 import java.nio.ByteBuffer
 
-import org.bblfsh.client.v2.libuast.Libuast.{UastIter, UastIterExt}
+import org.bblfsh.client.v2.libuast.Libuast.{UastHandleIter, UastIter, UastIterExt}
 
 /**
   * Represents Go-side constructed tree, result of Libuast.decode()
   *
   * This is equivalent of pyuast.ContextExt API
+  *
+  * A ContextExt is not thread-safe: it, its nodes, iterators and cursors
+  * must only be used by one thread at a time. Different contexts can be
+  * used in parallel, decode the UAST once per thread to query it concurrently.
   */
 case class ContextExt(nativeContext: Long) {
     import BblfshClient.{UastFormat, UastBinary}
+    import BblfshClient.{BoolKind, FloatKind, IntKind, StringKind, UintKind}
+
+    if (nativeContext != 0) NativeScope.register(dispose())
 
     // @native def load(): JNode // TODO(bzz): clarify when it's needed VS just .root().load()
     @native def root(): NodeExt
     @native def filter(query: String): UastIterExt
-    @native def nativeEncode(n: NodeExt, fmt: Int): ByteBuffer
+    /** Number of results of the query, counted natively without creating any NodeExt */
+    @native def count(query: String): Long
+    /** Checks natively if the query has any results, stops at the first one */
+    @native def exists(query: String): Boolean
+    /** Same as filter, but iterates over node handles without creating NodeExt */
+    @native def filterHandles(query: String): UastHandleIter
+
+    @native def filterMany(node: NodeExt, queries: Array[String]): Array[Array[Long]]
+    /**
+      * Evaluates all the queries under the given node with a single JNI call.
+      *
+      * Only the JNI overhead is shared: libuast still compiles each query
+      * and traverses the tree once per query.
+      *
+      * Returns the handles of the matches grouped by query, in the order of
+      * the queries. Use node(handle) to get a NodeExt of a match.
+      */
+    def filterAll(node: NodeExt, queries: Array[String]): Array[Array[Long]] =
+      filterMany(node, queries)
+    /** Same as filterAll(root(), queries) */
+    def filterAll(queries: Array[String]): Array[Array[Long]] = filterMany(null, queries)
+
+    /**
+      * Evaluates the query under the given node (or the root, if null) and
+      * returns the values of the results of the given kind, skipping others:
+      * long[] for ints and uints, double[] for floats, boolean[] for bools
+      * and a string table buffer of [[FlatJNode]] for strings.
+      *
+      * Meant for queries that select values, like count(//uast:Identifier)
+      * or //uast:Identifier/@Name: every result is copied natively to read it.
+      */
+    @native def filterValues(node: NodeExt, query: String, kind: Int): AnyRef
+
+    def filterInts(query: String): Array[Long] =
+      filterValues(null, query, IntKind.toInt).asInstanceOf[Array[Long]]
+    def filterUints(query: String): Array[Long] =
+      filterValues(null, query, UintKind.toInt).asInstanceOf[Array[Long]]
+    def filterFloats(query: String): Array[Double] =
+      filterValues(null, query, FloatKind.toInt).asInstanceOf[Array[Double]]
+    def filterBools(query: String): Array[Boolean] =
+      filterValues(null, query, BoolKind.toInt).asInstanceOf[Array[Boolean]]
+    def filterStrings(query: String): Array[String] =
+      FlatJNode.readStrings(filterValues(null, query, StringKind.toInt).asInstanceOf[ByteBuffer])
+
+    /** Promotes a node handle of this context to a NodeExt */
+    def node(handle: Long): NodeExt = NodeExt(this, handle)
+    @native def nativeEncode(n: NodeExt, fmt: Int): Array[Byte]
     def encode(n: NodeExt, fmt: UastFormat): ByteBuffer = {
-      nativeEncode(n, fmt)
+      ByteBuffer.wrap(nativeEncode(n, fmt))
     }
     // encode using binary format
     def encode(n: NodeExt): ByteBuffer = {
@@ -37,11 +90,17 @@ case class ContextExt(nativeContext: Long) {
 case class Context(nativeContext: Long) {
     import BblfshClient.{UastFormat, UastBinary}
 
+    if (nativeContext != 0) NativeScope.register(dispose())
+
     @native def root(): JNode
     @native def filter(query: String, node: JNode): UastIter
-    @native def nativeEncode(n: JNode, fmt: Int): ByteBuffer
+    /** Same as ContextExt.filterValues, for managed nodes */
+    @native def filterValues(node: JNode, query: String, kind: Int): AnyRef
+    /** Native memory held by this context for the mirrors of JNodes */
+    @native def arenaBytes(): Long
+    @native def nativeEncode(n: JNode, fmt: Int): Array[Byte]
     def encode(n: JNode, fmt: UastFormat): ByteBuffer = {
-      nativeEncode(n, fmt)
+      ByteBuffer.wrap(nativeEncode(n, fmt))
     }
     // encode using binary format
     def encode(n: JNode): ByteBuffer = {
@@ -56,4 +115,9 @@ case class Context(nativeContext: Long) {
 object Context {
     @native def create(): Long
     def apply(): Context = new Context(create())
+
+    /** Native memory held for the mirrors of JNodes by all live contexts */
+    @native def arenaTotalBytes(): Long
+    /** Peak of arenaTotalBytes() since the library was loaded */
+    @native def arenaPeakBytes(): Long
 }
@@ -0,0 +1,187 @@
+package org.bblfsh.client.v2
+
+import java.nio.charset.StandardCharsets
+import java.nio.{ByteBuffer, ByteOrder}
+
+import scala.collection.mutable
+
+/**
+  * Flat preorder representation of a UAST subtree, produced by
+  * [[NodeExt.loadBuffer]] and by write(), to pass whole trees over JNI.
+  * Nodes are numbered by their position in preorder, starting from 0.
+  *
+  * All values are in the native byte order:
+  *  - Int number of strings, then for each: Int length and UTF-8 bytes
+  *  - nodes in preorder, each is a Byte of the node kind followed by
+  *    - object: Int size, then size times an Int key index and a node
+  *    - array: Int size, then size nodes
+  *    - string: Int string index
+  *    - int, uint: Long
+  *    - float: Double
+  *    - bool: Byte
+  *    - null: nothing
+  *
+  * Moving the JNode tree this way takes a single JNI call for the whole
+  * subtree, instead of several calls per node.
+  */
+object FlatJNode {
+  import BblfshClient.{ArrayKind, BoolKind, FloatKind, IntKind, NullKind, ObjectKind, StringKind, UintKind}
+
+  /**
+    * Encodes the flat tree in the given buffer to the wire format,
+    * natively and without any calls back to the JVM.
+    */
+  @native def encode(flat: ByteBuffer, fmt: Int): Array[Byte]
+
+  /**
+    * Flattens the JNode tree to a new direct buffer.
+    *
+    * @return the buffer and all the nodes of the tree in preorder
+    */
+  def write(root: JNode): (ByteBuffer, Array[JNode]) = {
+    val w = new Writer(keepNodes = true)
+    w.node(root)
+    w.result()
+  }
+
+  /** Same as write(), without collecting the nodes */
+  def writeTree(root: JNode): ByteBuffer = {
+    val w = new Writer(keepNodes = false)
+    w.node(root)
+    w.result()._1
+  }
+
+  private class Writer(keepNodes: Boolean) {
+    private val index = mutable.HashMap[String, Int]()
+    private val strings = mutable.ArrayBuffer[Array[Byte]]()
+    private var stringBytes = 4
+    private var out = ByteBuffer.allocate(1 << 16).order(ByteOrder.nativeOrder())
+    private val nodes = mutable.ArrayBuffer[JNode]()
+
+    private def ensure(n: Int): Unit = if (out.remaining() < n) {
+      val grown = ByteBuffer.allocate((out.capacity() * 2).max(out.position() + n))
+        .order(ByteOrder.nativeOrder())
+      out.flip()
+      grown.put(out)
+      out = grown
+    }
+
+    private def kind(k: Int): Unit = {
+      ensure(1)
+      out.put(k.toByte)
+    }
+
+    private def int(v: Int): Unit = {
+      ensure(4)
+      out.putInt(v)
+    }
+
+    private def intern(str: String): Int = index.getOrElseUpdate(str, {
+      val bytes = str.getBytes(StandardCharsets.UTF_8)
+      strings += bytes
+      stringBytes += 4 + bytes.length
+      strings.size - 1
+    })
+
+    def node(n: JNode): Unit = {
+      if (keepNodes) nodes += n
+      n match {
+        case JObject(obj) =>
+          kind(ObjectKind.toInt)
+          int(obj.size)
+          for ((k, v) <- obj) {
+            int(intern(k))
+            node(v)
+          }
+        case JArray(arr) =>
+          kind(ArrayKind.toInt)
+          int(arr.size)
+          arr.foreach(node)
+        case JString(str) =>
+          kind(StringKind.toInt)
+          int(intern(str))
+        case JInt(num) =>
+          kind(IntKind.toInt)
+          ensure(8)
+          out.putLong(num)
+        case u: JUint =>
+          kind(UintKind.toInt)
+          ensure(8)
+          out.putLong(u.get())
+        case JFloat(num) =>
+          kind(FloatKind.toInt)
+          ensure(8)
+          out.putDouble(num)
+        case JBool(v) =>
+          kind(BoolKind.toInt)
+          ensure(1)
+          out.put((if (v) 1 else 0).toByte)
+        case JNothing =>
+          // same as Context.encode(), that sees an object with no fields
+          kind(ObjectKind.toInt)
+          int(0)
+        case _ =>
+          kind(NullKind.toInt)
+      }
+    }
+
+    def result(): (ByteBuffer, Array[JNode]) = {
+      out.flip()
+      val buf = ByteBuffer.allocateDirect(stringBytes + out.remaining())
+        .order(ByteOrder.nativeOrder())
+      buf.putInt(strings.size)
+      for (bytes <- strings) {
+        buf.putInt(bytes.length)
+        buf.put(bytes)
+      }
+      buf.put(out)
+      buf.flip()
+      (buf, nodes.toArray)
+    }
+  }
+
+  /** Decodes the JNode tree from the given buffer, without moving its position */
+  def read(buf: ByteBuffer): JNode = {
+    val in = buf.duplicate().order(ByteOrder.nativeOrder())
+    val strings = readStringTable(in)
+    readNode(in, strings)
+  }
+
+  /** Decodes a buffer that only contains a string table */
+  def readStrings(buf: ByteBuffer): Array[String] =
+    readStringTable(buf.duplicate().order(ByteOrder.nativeOrder()))
+
+  private def readStringTable(in: ByteBuffer): Array[String] = {
+    val strings = new Array[String](in.getInt())
+    for (i <- strings.indices) {
+      val bytes = new Array[Byte](in.getInt())
+      in.get(bytes)
+      strings(i) = new String(bytes, StandardCharsets.UTF_8)
+    }
+    strings
+  }
+
+  private def readNode(in: ByteBuffer, strings: Array[String]): JNode = in.get().toInt match {
+    case ObjectKind.toInt =>
+      val size = in.getInt()
+      val obj = new mutable.ArrayBuffer[JField](size)
+      for (_ <- 0 until size) {
+        val key = strings(in.getInt())
+        obj += ((key, readNode(in, strings)))
+      }
+      JObject(obj)
+    case ArrayKind.toInt =>
+      val size = in.getInt()
+      val arr = new mutable.ArrayBuffer[JNode](size)
+      for (_ <- 0 until size) {
+        arr += readNode(in, strings)
+      }
+      JArray(arr)
+    case StringKind.toInt => JString(strings(in.getInt()))
+    case IntKind.toInt => JInt(in.getLong())
+    case UintKind.toInt => JUint(in.getLong())
+    case FloatKind.toInt => JFloat(in.getDouble())
+    case BoolKind.toInt => JBool(in.get() != 0)
+    case _ => JNull()
+  }
+}
@@ -0,0 +1,33 @@
+package org.bblfsh.client.v2
+
+/**
+  * Read-only native snapshot of a managed JNode tree, for querying.
+  *
+  * The tree is flattened once and copied to native memory in a single JNI
+  * call, so queries never call back into the JVM. Results are mapped back to
+  * the original JNodes of the tree; values created by the query itself,
+  * like the result of count(), are returned as new JNodes.
+  *
+  * Later changes to the JNode tree are not reflected in the snapshot.
+  */
+class JNodeSnapshot(val root: JNode) {
+  private val (cursor, nodes) = {
+    val (buf, nodes) = FlatJNode.write(root)
+    (TreeCursor(buf), nodes)
+  }
+
+  /** Evaluates the XPath query, returns the matching nodes in order */
+  def filter(query: String): Seq[JNode] = {
+    val results = cursor.filterNodes(query)
+    for (i <- 0 until results.length by 2) yield {
+      val index = results(i)
+      if (index >= 0) nodes(index.toInt) else LazyJNode.copy(cursor, results(i + 1))
+    }
+  }
+
+  def dispose(): Unit = cursor.dispose()
+}
+
+object JNodeSnapshot {
+  def apply(root: JNode): JNodeSnapshot = new JNodeSnapshot(root)
+}
@@ -0,0 +1,119 @@
+package org.bblfsh.client.v2
+
+import scala.collection.mutable
+
+/**
+  * Lazily materialized JNode view of an external UAST.
+  *
+  * Objects and arrays are regular JObject and JArray nodes, backed by buffers
+  * that read each child from a native [[TreeCursor]] on first access and
+  * cache it. Reading the top levels of a large tree only creates JVM objects
+  * for the nodes actually touched.
+  *
+  * The view does not depend on the original ContextExt, which can be disposed
+  * right after the view is created. The native copy of the tree is released
+  * once the whole view becomes unreachable.
+  */
+object LazyJNode {
+  import BblfshClient.{ArrayKind, BoolKind, FloatKind, IntKind, ObjectKind, StringKind, UintKind}
+
+  /** Creates a lazy view of the given node */
+  def apply(node: NodeExt): JNode = {
+    val cursor = node.cursor()
+    wrap(cursor, cursor.root())
+  }
+
+  private[v2] def wrap(cursor: TreeCursor, node: Long): JNode = cursor.kind(node) match {
+    case ObjectKind.toInt => JObject(new LazyFields(cursor, node))
+    case ArrayKind.toInt => JArray(new LazyElements(cursor, node))
+    case StringKind.toInt => JString(cursor.asString(node))
+    case IntKind.toInt => JInt(cursor.asInt(node))
+    case UintKind.toInt => JUint(cursor.asUint(node))
+    case FloatKind.toInt => JFloat(cursor.asFloat(node))
+    case BoolKind.toInt => JBool(cursor.asBool(node))
+    case _ => JNull()
+  }
+
+  /** Copies the node eagerly, the copy does not depend on the cursor */
+  private[v2] def copy(cursor: TreeCursor, node: Long): JNode = cursor.kind(node) match {
+    case ObjectKind.toInt =>
+      val obj = new JObject()
+      for (i <- 0 until cursor.size(node)) {
+        obj.add(cursor.keyAt(node, i), copy(cursor, cursor.valueAt(node, i)))
+      }
+      obj
+    case ArrayKind.toInt =>
+      val size = cursor.size(node)
+      val arr = new JArray(size)
+      for (i <- 0 until size) {
+        arr.add(copy(cursor, cursor.valueAt(node, i)))
+      }
+      arr
+    case _ => wrap(cursor, node)
+  }
+}
+
+/**
+  * Buffer of the children of a native node, each child is read once
+  * and cached on the first access.
+  *
+  * Any modification materializes all the children first and
+  * detaches the buffer from the cursor.
+  */
+private[v2] abstract class LazyChildren[A <: AnyRef](cursor: TreeCursor, node: Long)
+  extends mutable.AbstractBuffer[A] {
+
+  private var cache = new Array[AnyRef](cursor.size(node))
+  private var strict: mutable.ArrayBuffer[A] = _
+
+  /** Reads the i-th child from the cursor */
+  protected def read(i: Int): A
+
+  override def length: Int = if (strict != null) strict.length else cache.length
+
+  override def apply(i: Int): A = {
+    if (strict != null) {
+      return strict(i)
+    }
+    if (i < 0 || i >= cache.length) {
+      throw new IndexOutOfBoundsException(i.toString)
+    }
+    var v = cache(i)
+    if (v == null) {
+      v = read(i)
+      cache(i) = v
+    }
+    v.asInstanceOf[A]
+  }
+
+  override def iterator: Iterator[A] =
+    if (strict != null) strict.iterator else Iterator.range(0, length).map(apply)
+
+  private def materialize(): mutable.ArrayBuffer[A] = {
+    if (strict == null) {
+      val all = mutable.ArrayBuffer.tabulate(cache.length)(apply)
+      strict = all
+      cache = null
+    }
+    strict
+  }
+
+  override def update(i: Int, v: A): Unit = materialize().update(i, v)
+  override def +=(v: A): this.type = { materialize() += v; this }
+  override def +=:(v: A): this.type = { v +=: materialize(); this }
+  override def insertAll(i: Int, vs: Traversable[A]): Unit = materialize().insertAll(i, vs)
+  override def remove(i: Int): A = materialize().remove(i)
+  override def clear(): Unit = materialize().clear()
+}
+
+private[v2] class LazyFields(cursor: TreeCursor, node: Long)
+  extends LazyChildren[JField](cursor, node) {
+  override protected def read(i: Int): JField =
+    (cursor.keyAt(node, i), LazyJNode.wrap(cursor, cursor.valueAt(node, i)))
+}
+
+private[v2] class LazyElements(cursor: TreeCursor, node: Long)
+  extends LazyChildren[JNode](cursor, node) {
+  override protected def read(i: Int): JNode =
+    LazyJNode.wrap(cursor, cursor.valueAt(node, i))
+}
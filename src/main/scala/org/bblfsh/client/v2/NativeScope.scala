@@ -0,0 +1,112 @@
+package org.bblfsh.client.v2
+
+import scala.collection.mutable
+
+/**
+  * Owns the native objects created by the current thread while it is open,
+  * and frees them all at once on close(), instead of waiting for the GC to
+  * run their finalizers.
+  *
+  * Covers contexts (ContextExt, Context), iterators, cursors and archives.
+  * Contexts and cursors used after the scope is closed throw a
+  * RuntimeException, closed iterators are empty.
+  *
+  * Scopes nest and are meant to be closed in the reverse order they were
+  * opened. If one is closed earlier, or from another thread, objects created
+  * later go to its nearest open ancestor.
+  *
+  * {{{
+  * NativeScope.run { _ =>
+  *   val ctx = resp.uast.decode()
+  *   ctx.filter("//uast:Identifier").size
+  * } // ctx and its iterator are freed here
+  * }}}
+  */
+final class NativeScope private (private val parent: NativeScope) extends AutoCloseable {
+  private val resources = mutable.ArrayBuffer[() => Unit]()
+  @volatile private var closed = false
+
+  def isClosed: Boolean = closed
+
+  /** Number of objects owned by the scope */
+  def size: Int = synchronized(resources.size)
+
+  private[v2] def own(release: () => Unit): Unit = synchronized {
+    if (closed) throw new IllegalStateException("NativeScope is closed")
+    resources += release
+  }
+
+  /** Frees everything the scope owns, in the reverse order of creation */
+  override def close(): Unit = {
+    val owned = synchronized {
+      if (closed) return
+      closed = true
+      val owned = resources.toArray
+      resources.clear()
+      owned
+    }
+    if (NativeScope.current.get eq this) {
+      NativeScope.current.set(NativeScope.openAncestor(parent))
+    }
+
+    var error: Throwable = null
+    for (release <- owned.reverseIterator) {
+      try release() catch {
+        case e: Throwable =>
+          if (error == null) error = e else error.addSuppressed(e)
+      }
+    }
+    if (error != null) throw error
+  }
+}
+
+object NativeScope {
+  private val current = new ThreadLocal[NativeScope]
+
+  /** The given scope if it is open, or its nearest open ancestor */
+  private def openAncestor(scope: NativeScope): NativeScope = {
+    var s = scope
+    while (s != null && s.closed) s = s.parent
+    s
+  }
+
+  /** Innermost open scope of the current thread, skipping the closed ones */
+  private def open(): NativeScope = {
+    val scope = current.get
+    val open = openAncestor(scope)
+    if (open ne scope) current.set(open)
+    open
+  }
+
+  /** Opens a new scope on the current thread */
+  def apply(): NativeScope = {
+    val scope = new NativeScope(open())
+    current.set(scope)
+    scope
+  }
+
+  /** Runs f in a new scope, that is closed when f returns or throws */
+  def run[T](f: NativeScope => T): T = {
+    val scope = apply()
+    try f(scope) finally scope.close()
+  }
+
+  /** Innermost open scope of the current thread, if any */
+  def active: Option[NativeScope] = Option(open())
+
+  /**
+    * Runs f without an open scope, for native objects owned and released
+    * by another one that is already registered.
+    */
+  private[v2] def unowned[T](f: => T): T = {
+    val scope = current.get
+    current.set(null)
+    try f finally current.set(scope)
+  }
+
+  /** Hands release to the open scope of the current thread, if there is one */
+  private[v2] def register(release: => Unit): Unit = {
+    val scope = open()
+    if (scope != null) scope.own(() => release)
+  }
+}
@@ -0,0 +1,43 @@
+package org.bblfsh.client.v2
+
+import org.bblfsh.client.v2.libuast.Libuast
+
+/**
+  * Snapshot of the objects and memory held by the native part of the client.
+  *
+  * The counters are always on and cheap to read, e.g. to export them as
+  * metrics and alert on leaks. Each of them is read atomically, but not all
+  * of them at the same instant.
+  *
+  * @param contextsExt        live ContextExt, the decoded UASTs
+  * @param contexts           live Context, including the ones of UastIter
+  * @param iterators          native iterators held by live or unclosed JVM ones
+  * @param nodes              native mirrors of JNodes held by the live contexts
+  * @param globalRefsCreated  JNI global and weak global references created
+  * @param globalRefsDeleted  JNI global and weak global references deleted
+  * @param decodedBytes       encoded size of the UASTs of the live ContextExt,
+  *                           an estimate of the memory they hold
+  * @param encodedBytes       size of the encoded buffers held natively, only
+  *                           while encode() copies them to the JVM heap
+  */
+case class NativeStats(contextsExt: Long,
+                       contexts: Long,
+                       iterators: Long,
+                       nodes: Long,
+                       globalRefsCreated: Long,
+                       globalRefsDeleted: Long,
+                       decodedBytes: Long,
+                       encodedBytes: Long) {
+  /** Global references held at the moment */
+  def globalRefs: Long = globalRefsCreated - globalRefsDeleted
+}
+
+object NativeStats {
+  private lazy val libuast = new Libuast
+
+  /** Reads the current values of the native counters */
+  def apply(): NativeStats = {
+    val s = libuast.stats()
+    NativeStats(s(0), s(1), s(2), s(3), s(4), s(5), s(6), s(7))
+  }
+}
@@ -18,6 +18,21 @@ import scala.collection.mutable
 case class NodeExt(ctx: ContextExt, handle: Long) {
   @native def load(): JNode
   @native def filter(query: String): UastIterExt
+
+  /** Evaluates all the queries under this node, see [[ContextExt.filterAll]] */
+  def filterAll(queries: Array[String]): Array[Array[Long]] = ctx.filterAll(this, queries)
+
+  /** Writes this subtree to a direct buffer, in the format of [[FlatJNode]] */
+  @native def loadBuffer(): ByteBuffer
+
+  /** Same as load(), but transfers the whole subtree in a single JNI call */
+  def loadFlat(): JNode = FlatJNode.read(loadBuffer())
+
+  /** Native read-only cursor over this subtree, see [[TreeCursor]] */
+  def cursor(): TreeCursor = TreeCursor(this)
+
+  /** Lazily materialized JNode view of this subtree, see [[LazyJNode]] */
+  def lazyLoad(): JNode = LazyJNode(this)
 }
 
 
@@ -31,11 +46,7 @@ sealed abstract class JNode {
   import BblfshClient.{UastFormat, UastBinary}
 
   def toByteArray(fmt: UastFormat): Array[Byte] = {
-    val buf = toByteBuffer(fmt)
-    val arr = new Array[Byte](buf.capacity())
-    buf.get(arr)
-    buf.rewind()
-    arr
+    FlatJNode.encode(FlatJNode.writeTree(this), fmt.toInt)
   }
 
   /** Use binary UAST format */
@@ -43,11 +54,16 @@ sealed abstract class JNode {
     toByteArray(UastBinary)
   }
 
+  /**
+    * Encodes the tree to the given format.
+    *
+    * The tree is flattened in Scala and encoded natively in a single JNI
+    * call. Context.encode() gives the same bytes through a call per node,
+    * JNothing is encoded as an empty object by both. The result is a heap
+    * buffer, no native memory is held once it returns.
+    */
   def toByteBuffer(fmt: UastFormat): ByteBuffer = {
-    val ctx = Context()
-    val bb = ctx.encode(this, fmt)
-    ctx.dispose()
-    bb
+    ByteBuffer.wrap(toByteArray(fmt))
   }
 
   /** Use binary UAST format */
@@ -55,6 +71,13 @@ sealed abstract class JNode {
     toByteBuffer(UastBinary)
   }
 
+  /**
+    * Kind of the node, one of the JNode.*Tag constants.
+    *
+    * Read from JNI with a single call, instead of testing the class.
+    */
+  def kindTag: Int = JNode.ObjectTag
+
   /* Dynamic dispatch is a convenience to be called from JNI */
   def children: Seq[JNode] = this match {
     case JObject(l) => l map (_._2)
@@ -84,13 +107,25 @@ sealed abstract class JNode {
     case o: JObject => o.obj.filter(_._1 == k).head._2
     case _ => JNothing
   }
+
+  /** Read-only native snapshot of this tree for querying, see [[JNodeSnapshot]] */
+  def snapshot(): JNodeSnapshot = JNodeSnapshot(this)
 }
 
 object JNode {
   import BblfshClient.{UastFormat, UastBinary}
 
-  private def decodeFrom(bytes: ByteBuffer, fmt: UastFormat): JNode = {
-    val ctx = BblfshClient.decode(bytes, fmt)
+  // Values of kindTag, in the order of Libuast.NodeKind
+  final val NullTag = 0
+  final val ObjectTag = 1
+  final val ArrayTag = 2
+  final val StringTag = 3
+  final val IntTag = 4
+  final val UintTag = 5
+  final val FloatTag = 6
+  final val BoolTag = 7
+
+  private def decodeFrom(ctx: ContextExt): JNode = {
     val node = ctx.root().load()
     ctx.dispose()
     node
@@ -99,24 +134,14 @@ object JNode {
   /**
     * Decodes UAST from the given Buffer.
     *
-    * If the buffer is Direct, it will avoid extra memory allocation,
-    * otherwise it will copy the content to a new Direct buffer.
+    * Decoded like BblfshClient.decode(): direct buffers in place, heap ones
+    * with a single native copy and no pinning.
     *
     * @param original UAST encoded in wire format of protocol.v2
     * @return JNode of the UAST root
     */
   def parseFrom(original: ByteBuffer, fmt: UastFormat): JNode = {
-    val bufDirect = if (!original.isDirect) {
-      val bufDirectCopy = ByteBuffer.allocateDirect(original.capacity())
-      original.rewind()
-      bufDirectCopy.put(original)
-      original.rewind()
-      bufDirectCopy.flip()
-      bufDirectCopy
-    } else {
-      original
-    }
-    decodeFrom(bufDirect, fmt)
+    decodeFrom(BblfshClient.decode(original, fmt))
   }
 
   /** Parse from a buffer using binary UAST format */
@@ -125,19 +150,13 @@ object JNode {
   }
 
   /**
-    * Decodes UAST from the given bytes.
-    *
-    * It will copy memory into temporary Direct buffer,
-    * otherwise it will copy the content to a new Direct buffer.
+    * Decodes UAST from the given bytes, see BblfshClient.decode().
     *
     * @param bytes UAST encoded in wire format of protocol.v2
     * @return JNode of the UAST root
     */
   def parseFrom(bytes: Array[Byte], fmt: UastFormat): JNode = {
-    val bufDirect = ByteBuffer.allocateDirect(bytes.size)
-    bufDirect.put(bytes)
-    bufDirect.flip()
-    decodeFrom(bufDirect, fmt)
+    decodeFrom(BblfshClient.decode(bytes, fmt))
   }
 
   /** Parse from an array using binary UAST format */
@@ -147,14 +166,25 @@ object JNode {
 }
 
 case object JNothing extends JNode // 'zero' value for JNode
-case class JNull() extends JNode
-case class JString(str: String) extends JNode
-case class JFloat(num: Double) extends JNode
+case class JNull() extends JNode {
+  override def kindTag: Int = JNode.NullTag
+}
+case class JString(str: String) extends JNode {
+  override def kindTag: Int = JNode.StringTag
+}
+case class JFloat(num: Double) extends JNode {
+  override def kindTag: Int = JNode.FloatTag
+}
 case class JUint(num: Long) extends JNode {
+  override def kindTag: Int = JNode.UintTag
   def get(): Long = java.lang.Integer.toUnsignedLong(num.toInt)
 }
-case class JInt(num: Long) extends JNode
-case class JBool(value: Boolean) extends JNode
+case class JInt(num: Long) extends JNode {
+  override def kindTag: Int = JNode.IntTag
+}
+case class JBool(value: Boolean) extends JNode {
+  override def kindTag: Int = JNode.BoolTag
+}
 
 case class JObject(obj: mutable.Buffer[JField]) extends JNode {
   def this() = this(mutable.Buffer[JField]())
@@ -179,6 +209,7 @@ case object JObject {
 }
 
 case class JArray(arr: mutable.Buffer[JNode]) extends JNode {
+  override def kindTag: Int = JNode.ArrayTag
   def this(size: Int) = this(new mutable.ArrayBuffer[JNode](size))
   def filter(p: JNode => Boolean) = this.arr.filter(p)
   def add(n: JNode) = {
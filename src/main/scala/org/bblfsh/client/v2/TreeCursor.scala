@@ -0,0 +1,73 @@
+package org.bblfsh.client.v2
+
+import java.nio.ByteBuffer
+
+/**
+  * Read-only native cursor over a subtree of an external UAST.
+  *
+  * The subtree of the given NodeExt is copied once to native memory, no JVM
+  * objects are built for it. Nodes are addressed by opaque Long handles,
+  * starting from root(), and all accessors return either primitives or
+  * other handles. 0 is the handle of a null node.
+  *
+  * Handles are only valid until the cursor is disposed.
+  *
+  * {{{
+  * val cur = ctx.root().cursor()
+  * val root = cur.root()
+  * cur.asString(cur.get(root, "@type"))
+  * cur.dispose()
+  * }}}
+  */
+case class TreeCursor(nativeCursor: Long) {
+    import BblfshClient.{ArrayKind, ObjectKind}
+
+    if (nativeCursor != 0) NativeScope.register(dispose())
+
+    /** Handle of the root node of the subtree */
+    @native def root(): Long
+
+    /** Kind of the node, one of BblfshClient.NodeKind values */
+    @native def kind(node: Long): Int
+    /** Number of fields of an object, elements of an array or length of a string */
+    @native def size(node: Long): Int
+    /** Key of the i-th field of an object, null if there is none */
+    @native def keyAt(node: Long, i: Int): String
+    /** Handle of the i-th field of an object or element of an array */
+    @native def valueAt(node: Long, i: Int): Long
+    /** Handle of the value of the given key of an object, 0 if there is none */
+    @native def get(node: Long, key: String): Long
+
+    @native def asInt(node: Long): Long
+    @native def asUint(node: Long): Long
+    @native def asFloat(node: Long): Double
+    @native def asBool(node: Long): Boolean
+    /** Value of a string node, null for other kinds */
+    @native def asString(node: Long): String
+
+    def isObject(node: Long): Boolean = kind(node) == ObjectKind.toInt
+    def isArray(node: Long): Boolean = kind(node) == ArrayKind.toInt
+
+    /**
+      * Evaluates the query natively over the cursor tree.
+      *
+      * Returns pairs of longs for each result: its preorder index, if the
+      * cursor was created from a flat buffer, or -1, and its node handle.
+      * Results created by the query (e.g. by count()) have index -1.
+      */
+    @native def filterNodes(query: String): Array[Long]
+
+    @native def dispose()
+    override def finalize(): Unit = {
+      this.dispose()
+    }
+}
+
+object TreeCursor {
+    @native def create(node: NodeExt): Long
+    def apply(node: NodeExt): TreeCursor = new TreeCursor(create(node))
+
+    /** Reads the tree from a direct buffer in the [[FlatJNode]] format */
+    @native def fromBuffer(buf: ByteBuffer): Long
+    def apply(buf: ByteBuffer): TreeCursor = new TreeCursor(fromBuffer(buf))
+}
@@ -0,0 +1,238 @@
+package org.bblfsh.client.v2
+
+import java.nio.{ByteBuffer, ByteOrder}
+import java.nio.channels.FileChannel
+import java.nio.charset.StandardCharsets.UTF_8
+import java.nio.file.{Paths, StandardOpenOption}
+import java.security.MessageDigest
+
+import com.google.protobuf.ByteString
+
+import scala.collection.mutable
+
+/**
+  * Read-only archive of encoded UASTs, written by [[UastArchive.Writer]].
+  *
+  * The archive is memory-mapped natively and only its index is read on
+  * open, any entry is then found by its key and decoded directly from the
+  * mapped pages, without reading the other ones.
+  *
+  * Contexts decoded from the archive keep it mapped and remain valid
+  * after the archive is disposed.
+  *
+  * {{{
+  * val archive = UastArchive("repo.uar")
+  * val ctx = archive.decode("src/Main.java")
+  * archive.dispose()
+  * }}}
+  */
+case class UastArchive(nativeArchive: Long) {
+    import BblfshClient.{UastFormat, UastBinary}
+
+    if (nativeArchive != 0) NativeScope.register(dispose())
+
+    /** Number of entries, including the ones with repeated keys */
+    @native def size(): Int
+    @native def keyBytes(i: Int): Array[Byte]
+    @native def containsKey(key: Array[Byte]): Boolean
+    @native def metadataOf(key: Array[Byte]): Array[Byte]
+    @native def decodeEntry(key: Array[Byte], fmt: Int): ContextExt
+
+    /** Key of the i-th entry, in the order they were added */
+    def keyAt(i: Int): String = {
+      val key = keyBytes(i)
+      if (key == null) null else new String(key, UTF_8)
+    }
+
+    def keys(): Seq[String] = (0 until size()).map(keyAt)
+
+    def contains(key: String): Boolean = containsKey(key.getBytes(UTF_8))
+
+    /** Metadata of the entry, empty if it was added without any */
+    def metadata(key: String): Option[Array[Byte]] = Option(metadataOf(key.getBytes(UTF_8)))
+
+    /** Decodes the entry of the given key, throws if there is none */
+    def decode(key: String, fmt: UastFormat): ContextExt =
+      decodeEntry(key.getBytes(UTF_8), fmt.toInt)
+
+    def decode(key: String): ContextExt = decode(key, UastBinary)
+
+    @native def dispose()
+    override def finalize(): Unit = {
+      this.dispose()
+    }
+}
+
+/**
+  * Archive format, all integers are little-endian:
+  *
+  *  - header: "BUAR", Int version
+  *  - data: UAST blobs and their metadata, appended one after another
+  *  - index: per entry, Int key length, key bytes in UTF-8, Long offset,
+  *    Long length, Long metadata offset, Int metadata length
+  *  - footer: Long index offset, Int number of entries, "BUAR"
+  *
+  * If a key appears more than once, the last entry wins.
+  */
+object UastArchive {
+    val Magic: Array[Byte] = "BUAR".getBytes(UTF_8)
+    val Version = 1
+    val HeaderSize = 8
+    val FooterSize = 16
+
+    @native def open(path: String): Long
+    def apply(path: String): UastArchive = new UastArchive(open(path))
+
+    /** Hex SHA-256 of the content, a key for entries addressed by content */
+    def contentKey(uast: Array[Byte]): String = {
+      val digest = MessageDigest.getInstance("SHA-256").digest(uast)
+      digest.map("%02x".format(_)).mkString
+    }
+
+    /** Creates a new archive at the given path, replacing any existing file */
+    def create(path: String): Writer = {
+      val ch = FileChannel.open(Paths.get(path), StandardOpenOption.CREATE,
+        StandardOpenOption.TRUNCATE_EXISTING, StandardOpenOption.WRITE)
+      val w = new Writer(ch, mutable.ArrayBuffer[Entry]())
+      w.writeHeader()
+      w
+    }
+
+    /**
+      * Opens an existing archive to add more entries.
+      *
+      * The data written so far is kept as is, new entries are added
+      * after it and the index is rewritten on close.
+      */
+    def append(path: String): Writer = {
+      val ch = FileChannel.open(Paths.get(path),
+        StandardOpenOption.READ, StandardOpenOption.WRITE)
+      try {
+        val entries = readIndex(ch, path)
+        new Writer(ch, entries)
+      } catch {
+        case e: Throwable =>
+          ch.close()
+          throw e
+      }
+    }
+
+    private case class Entry(key: Array[Byte], offset: Long, length: Long,
+                             metaOffset: Long, metaLength: Int)
+
+    private def readFully(ch: FileChannel, buf: ByteBuffer, pos: Long): ByteBuffer = {
+      var p = pos
+      while (buf.hasRemaining) {
+        val n = ch.read(buf, p)
+        if (n < 0) throw new RuntimeException("malformed UAST archive: truncated")
+        p += n
+      }
+      buf.flip()
+      buf
+    }
+
+    private def readIndex(ch: FileChannel, path: String): mutable.ArrayBuffer[Entry] = {
+      val size = ch.size()
+      if (size < HeaderSize + FooterSize) {
+        throw new RuntimeException(s"$path is not a UAST archive")
+      }
+      val footer = readFully(ch,
+        ByteBuffer.allocate(FooterSize).order(ByteOrder.LITTLE_ENDIAN), size - FooterSize)
+      val indexOffset = footer.getLong()
+      val count = footer.getInt()
+      val magic = new Array[Byte](4)
+      footer.get(magic)
+      if (!magic.sameElements(Magic) || indexOffset < HeaderSize || indexOffset > size - FooterSize) {
+        throw new RuntimeException(s"$path is not a UAST archive")
+      }
+
+      val index = readFully(ch, ByteBuffer.allocate((size - FooterSize - indexOffset).toInt)
+        .order(ByteOrder.LITTLE_ENDIAN), indexOffset)
+      val entries = new mutable.ArrayBuffer[Entry](count)
+      for (_ <- 0 until count) {
+        val key = new Array[Byte](index.getInt())
+        index.get(key)
+        entries += Entry(key, index.getLong(), index.getLong(), index.getLong(), index.getInt())
+      }
+      ch.position(indexOffset)
+      entries
+    }
+
+    /**
+      * Appends encoded UASTs to an archive.
+      *
+      * Entries are written as they are added, the index and the footer on
+      * close(). An archive that was not closed has no valid index.
+      * Not thread-safe.
+      */
+    class Writer private[UastArchive] (ch: FileChannel, entries: mutable.ArrayBuffer[Entry])
+        extends AutoCloseable {
+      private var closed = false
+
+      private def write(buf: ByteBuffer): Unit = {
+        while (buf.hasRemaining) ch.write(buf)
+      }
+
+      private[UastArchive] def writeHeader(): Unit = {
+        val header = ByteBuffer.allocate(HeaderSize).order(ByteOrder.LITTLE_ENDIAN)
+        header.put(Magic).putInt(Version).flip()
+        write(header)
+      }
+
+      /** Number of entries, including the ones added before an append */
+      def size: Int = entries.size
+
+      /** Adds the remaining bytes of the buffer as the UAST of the key */
+      def add(key: String, uast: ByteBuffer, metadata: Array[Byte]): Unit = {
+        if (closed) throw new IllegalStateException("UastArchive.Writer is closed")
+
+        val offset = ch.position()
+        val length = uast.remaining()
+        write(uast.duplicate())
+        val meta = if (metadata == null) Array.emptyByteArray else metadata
+        write(ByteBuffer.wrap(meta))
+        entries += Entry(key.getBytes(UTF_8), offset, length, offset + length, meta.length)
+      }
+
+      def add(key: String, uast: Array[Byte], metadata: Array[Byte]): Unit =
+        add(key, ByteBuffer.wrap(uast), metadata)
+
+      def add(key: String, uast: Array[Byte]): Unit = add(key, uast, null)
+
+      def add(key: String, uast: ByteString, metadata: Array[Byte]): Unit =
+        add(key, uast.asReadOnlyByteBuffer(), metadata)
+
+      def add(key: String, uast: ByteString): Unit = add(key, uast, null)
+
+      /** Adds the UAST under its [[UastArchive.contentKey]], returns the key */
+      def addByHash(uast: Array[Byte], metadata: Array[Byte]): String = {
+        val key = contentKey(uast)
+        add(key, uast, metadata)
+        key
+      }
+
+      def addByHash(uast: Array[Byte]): String = addByHash(uast, null)
+
+      /** Writes the index and the footer, and closes the file */
+      override def close(): Unit = {
+        if (closed) return
+        closed = true
+        try {
+          val indexOffset = ch.position()
+          val indexSize = entries.map(_.key.length + 32).sum
+          val index = ByteBuffer.allocate(indexSize + FooterSize).order(ByteOrder.LITTLE_ENDIAN)
+          for (e <- entries) {
+            index.putInt(e.key.length).put(e.key)
+              .putLong(e.offset).putLong(e.length)
+              .putLong(e.metaOffset).putInt(e.metaLength)
+          }
+          index.putLong(indexOffset).putInt(entries.size).put(Magic).flip()
+          write(index)
+          // drops what is left of a previous index after an append
+          ch.truncate(ch.position())
+        } finally {
+          ch.close()
+        }
+      }
+    }
+}
@@ -1,6 +1,6 @@
 package org.bblfsh.client.v2.libuast
 
-import org.bblfsh.client.v2.{ContextExt, Context, JNode, NodeExt}
+import org.bblfsh.client.v2.{ContextExt, Context, JNode, NativeScope, NodeExt}
 import org.bblfsh.client.v2.libuast.Libuast.UastIterExt
 
 import scala.collection.Iterator
@@ -32,40 +32,73 @@ object Libuast {
     positionOrder: Int
   )
 
+  case class NodeKind(
+    nullKind: Int,
+    objectKind: Int,
+    arrayKind: Int,
+    stringKind: Int,
+    intKind: Int,
+    uintKind: Int,
+    floatKind: Int,
+    boolKind: Int
+  )
+
+  /** Number of nodes an iterator fetches from libuast per JNI call, by default */
+  val DefaultBatchSize = 64
+
   /**
     * Skeletal Node iterator implementation that delegates to Libuast.
     *
     * It brides the gap between the contracts of a Scala iterator (.hasNext()/.next()) and
     * a native Libuast iterator (.next() == null at the end).
+    *
+    * Nodes are fetched from the native side in batches of up to batchSize
+    * and served from a buffer, so there is one JNI call per batch, not per node.
     **/
   abstract class UastAbstractIter[T >: Null](var node: T, var treeOrder: Int, var iter: Long)
       extends Iterator[T] {
     private var closed = false
-    private var nextNode: Option[T] = None
+    private var batch: Array[T] = null
+    private var pos = 0
+
+    NativeScope.register(close())
 
-    private def lookahead(): Option[T] = {
-      val node = nativeNext(iter)
-      if (node == null) {
+    /** Maximum number of nodes to fetch per JNI call */
+    var batchSize: Int = DefaultBatchSize
+
+    /** Sets the number of nodes to fetch per JNI call, returns this iterator */
+    def withBatchSize(n: Int): this.type = {
+      require(n > 0, s"batch size must be positive, got $n")
+      batchSize = n
+      this
+    }
+
+    private def buffered: Boolean = batch != null && pos < batch.length
+
+    private def fetch(): Boolean = {
+      batch = nativeNextBatch(iter, batchSize)
+      pos = 0
+      if (batch == null || batch.length == 0) {
         close()
-        None
+        false
       } else {
-        Some(node)
+        true
       }
     }
 
     /** True only if the next element is not null */
-    override def hasNext(): Boolean = if (closed) {
-      false
-    } else if (nextNode.isDefined) {
+    override def hasNext(): Boolean = if (buffered) {
       true
+    } else if (closed) {
+      false
     } else {
-      nextNode = lookahead()
-      nextNode.isDefined
+      fetch()
     }
 
     override def next(): T = if (hasNext()) {
-      val next = nextNode.get
-      nextNode = None
+      val next = batch(pos)
+      batch(pos) = null
+      pos += 1
       next
     } else {
       null
@@ -76,9 +109,11 @@ object Libuast {
         nativeDispose()
         closed = true
       }
+      batch = null
     }
 
     def nativeNext(iterPtr: Long): T
+    def nativeNextBatch(iterPtr: Long, n: Int): Array[T]
     def nativeInit()
     def nativeDispose()
 
@@ -91,13 +126,114 @@ object Libuast {
   class UastIterExt(node: NodeExt, treeOrder: Int, iter: Long, var ctx: ContextExt)
     extends UastAbstractIter(node, treeOrder, iter) {
     @native def nativeNext(iterPtr: Long): NodeExt
+    @native def nativeNextBatch(iterPtr: Long, n: Int): Array[NodeExt]
     @native def nativeInit()
     @native def nativeDispose()
   }
 
   object UastIterExt {
     def apply(node: NodeExt, treeOrder: Int): UastIterExt = {
-      val it = new UastIterExt(node, treeOrder, 0, ContextExt(0))
+      apply(node, treeOrder, DefaultBatchSize)
+    }
+
+    def apply(node: NodeExt, treeOrder: Int, batchSize: Int): UastIterExt = {
+      val it = new UastIterExt(node, treeOrder, 0, ContextExt(0)).withBatchSize(batchSize)
+      it.nativeInit()
+      it
+    }
+  }
+
+  /**
+    * Iterator over the handles of the nodes of an external/native UAST.
+    *
+    * Unlike UastIterExt it does not allocate a NodeExt per node: handles are
+    * copied from libuast in batches into a primitive array. A handle can be
+    * promoted to a NodeExt on demand with ContextExt.node(handle).
+    *
+    * Handles are only valid while the ContextExt they come from is alive.
+    */
+  class UastHandleIter(var node: NodeExt, var treeOrder: Int, var iter: Long, var ctx: ContextExt) {
+    private var closed = false
+    private var batch = new Array[Long](DefaultBatchSize)
+    private var count = 0
+    private var pos = 0
+
+    NativeScope.register(close())
+
+    /** Sets the number of handles to fetch per JNI call, returns this iterator */
+    def withBatchSize(n: Int): this.type = {
+      require(n > 0, s"batch size must be positive, got $n")
+      batch = new Array[Long](n)
+      this
+    }
+
+    /** True if there are more handles to read */
+    def hasNext: Boolean = if (pos < count) {
+      true
+    } else if (closed) {
+      false
+    } else {
+      count = nativeNextHandles(iter, batch)
+      pos = 0
+      if (count == 0) close()
+      count > 0
+    }
+
+    /** Returns the next handle, or 0 if there are no more */
+    def next(): Long = if (hasNext) {
+      val handle = batch(pos)
+      pos += 1
+      handle
+    } else {
+      0
+    }
+
+    /**
+      * Copies up to out.length next handles to out, returns how many were copied.
+      * Returns 0 once all the handles were read.
+      */
+    def nextHandles(out: Array[Long]): Int = if (pos < count) {
+      val n = math.min(count - pos, out.length)
+      System.arraycopy(batch, pos, out, 0, n)
+      pos += n
+      n
+    } else if (closed) {
+      0
+    } else {
+      val n = nativeNextHandles(iter, out)
+      if (n == 0) close()
+      n
+    }
+
+    /** Applies f to all the remaining handles */
+    def foreach(f: Long => Unit): Unit = {
+      while (hasNext) f(next())
+    }
+
+    def close() = {
+      if (!closed) {
+        nativeDispose()
+        closed = true
+      }
+      count = 0
+    }
+
+    @native def nativeNextHandles(iterPtr: Long, out: Array[Long]): Int
+    @native def nativeInit()
+    @native def nativeDispose()
+
+    override def finalize(): Unit = {
+      this.nativeDispose()
+    }
+  }
+
+  object UastHandleIter {
+    def apply(node: NodeExt, treeOrder: Int): UastHandleIter = {
+      apply(node, treeOrder, DefaultBatchSize)
+    }
+
+    def apply(node: NodeExt, treeOrder: Int, batchSize: Int): UastHandleIter = {
+      val it = new UastHandleIter(node, treeOrder, 0, ContextExt(0)).withBatchSize(batchSize)
       it.nativeInit()
       it
     }
@@ -106,15 +242,35 @@ object Libuast {
   /** Iterator over children of the given managed node */
   class UastIter(node: JNode, treeOrder: Int, iter: Long, var ctx: Context)
     extends UastAbstractIter(node, treeOrder, iter) {
+    // context created by nativeInit() for this iterator only, released
+    // right after the native iterator that uses it
+    private var ownCtx: Context = null
+
+    override def close() = {
+      super.close()
+      if (ownCtx != null) {
+        ownCtx.dispose()
+        ownCtx = null
+      }
+    }
+
     @native def nativeNext(iterPtr: Long): JNode
+    @native def nativeNextBatch(iterPtr: Long, n: Int): Array[JNode]
     @native def nativeInit()
     @native def nativeDispose()
   }
 
   object UastIter {
     def apply(node: JNode, treeOrder: Int): UastIter = {
-      val it = new UastIter(node, treeOrder, 0, Context(0))
-      it.nativeInit()
+      apply(node, treeOrder, DefaultBatchSize)
+    }
+
+    def apply(node: JNode, treeOrder: Int, batchSize: Int): UastIter = {
+      val it = new UastIter(node, treeOrder, 0, Context(0)).withBatchSize(batchSize)
+      // the iterator is registered already and disposes the context itself,
+      // so that a scope never frees the context before the iterator
+      NativeScope.unowned(it.nativeInit())
+      it.ownCtx = it.ctx
       it
     }
   }
@@ -160,9 +316,35 @@ class Libuast {
     */
   @native def decode(buf: ByteBuffer, fmt: Int): ContextExt
 
+  /** Decode UAST from a range of a byte array.
+    * The range is copied once to native memory held by the context,
+    * the array is not pinned.
+    */
+  @native def decodeBytes(bytes: Array[Byte], offset: Int, length: Int, fmt: Int): ContextExt
+
+  /** Decode UAST from a file, memory-mapped for as long as the context is not disposed */
+  @native def decodeFile(path: String, fmt: Int): ContextExt
+
+  /** Decodes all the direct buffers and counts the results of each query
+    * in them on a native thread pool, see [[org.bblfsh.client.v2.BatchFilter]]
+    */
+  @native def countBatch(buffers: Array[ByteBuffer], queries: Array[String],
+                         fmt: Int, threads: Int): Array[Long]
+
   /** Lifts the tree order values from the libuast */
   @native def getTreeOrders: Libuast.TreeOrder
 
   /** Lifts the uast decoding / encoding options from the libuast */
   @native def getUastFormats: Libuast.UastFormat
+
+  /** Lifts the kinds of UAST nodes from the libuast */
+  @native def getNodeKinds: Libuast.NodeKind
+
+  /** Number of native allocations made so far, or -1 if the library
+    * was not built with allocation counting (./build.sh --compile-test)
+    */
+  @native def allocations(): Long
+
+  /** Raw native counters, see [[org.bblfsh.client.v2.NativeStats]] */
+  @native def stats(): Array[Long]
 }
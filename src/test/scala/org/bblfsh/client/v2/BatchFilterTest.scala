@@ -0,0 +1,60 @@
+package org.bblfsh.client.v2
+
+import java.nio.ByteBuffer
+
+class BatchFilterTest extends BblfshClientBaseTest {
+
+  import BblfshClient._ // enables uast.* methods
+
+  val queries = Seq("//uast:Identifier", "//uast:Position", "//*[@role='Import']")
+
+  def direct(buf: ByteBuffer): ByteBuffer = {
+    val copy = ByteBuffer.allocateDirect(buf.capacity())
+    copy.put(buf.duplicate())
+    copy.flip()
+    copy
+  }
+
+  def expected(): Seq[Long] = {
+    val ctx = resp.uast.decode()
+    val counts = queries.map(ctx.count)
+    ctx.dispose()
+    counts
+  }
+
+  "BatchFilter.count" should "match ContextExt.count on a single thread" in {
+    val buffers = Seq(resp.uast.asReadOnlyByteBuffer, direct(resp.uast.asReadOnlyByteBuffer))
+    val counts = BatchFilter.count(buffers, queries, 1)
+
+    counts.buffers should be(2)
+    counts.of(0) should equal(expected().toArray)
+    counts.of(1) should equal(expected().toArray)
+  }
+
+  "BatchFilter.count" should "match ContextExt.count on many threads" in {
+    val buffers = Seq.fill(16)(resp.uast.asReadOnlyByteBuffer)
+    val counts = BatchFilter.count(buffers, queries, 4)
+
+    val want = expected().toArray
+    counts.buffers should be(16)
+    for (i <- 0 until counts.buffers) {
+      counts.failed(i) should be(false)
+      counts.of(i) should equal(want)
+    }
+  }
+
+  "BatchFilter.count" should "mark the buffers that cannot be decoded" in {
+    val garbage = ByteBuffer.allocateDirect(64)
+    while (garbage.hasRemaining) garbage.put(0xff.toByte)
+    garbage.flip()
+
+    val buffers = Seq(resp.uast.asReadOnlyByteBuffer, garbage, resp.uast.asReadOnlyByteBuffer)
+    val counts = BatchFilter.count(buffers, queries, 2)
+
+    counts.failed(0) should be(false)
+    counts.failed(1) should be(true)
+    counts.of(1) should equal(Array.fill(queries.size)(-1L))
+    counts.of(2) should equal(expected().toArray)
+  }
+
+}
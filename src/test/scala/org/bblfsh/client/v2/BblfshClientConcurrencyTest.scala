@@ -0,0 +1,56 @@
+package org.bblfsh.client.v2
+
+import java.util.concurrent.{Callable, Executors, TimeUnit}
+
+import scala.collection.JavaConverters._
+
+class BblfshClientConcurrencyTest extends BblfshClientBaseTest {
+
+  import BblfshClient._ // enables uast.* methods
+  import BblfshClientConcurrencyTest._
+
+  override val fileName = "src/test/resources/large.php"
+
+  val query = "//uast:Identifier"
+  val iterations = 8
+
+  /** Decodes and filters the parsed UAST, returns the number of matches */
+  def decodeAndFilter(): Int = {
+    val ctx = resp.uast.decode()
+    val it = BblfshClient.filter(ctx.root(), query)
+    val matches = it.size
+    it.close()
+    ctx.dispose()
+    matches
+  }
+
+  "Concurrent decode and filter" should "return the same results as a single thread" in {
+    val expected = decodeAndFilter()
+    expected should be > 0
+
+    val threads = Runtime.getRuntime.availableProcessors.max(2)
+    val results = runConcurrently(threads, threads * iterations)(decodeAndFilter())
+
+    results should have size (threads * iterations)
+    all (results) should be (expected)
+  }
+
+}
+
+object BblfshClientConcurrencyTest {
+  /** Runs f the given number of times on a pool of threads, returns all the results */
+  def runConcurrently[T](threads: Int, times: Int)(f: => T): Seq[T] = {
+    val pool = Executors.newFixedThreadPool(threads)
+    try {
+      val tasks = (1 to times).map { _ =>
+        new Callable[T] {
+          override def call(): T = f
+        }
+      }
+      pool.invokeAll(tasks.asJava).asScala.map(_.get)
+    } finally {
+      pool.shutdown()
+      pool.awaitTermination(1, TimeUnit.MINUTES)
+    }
+  }
+}
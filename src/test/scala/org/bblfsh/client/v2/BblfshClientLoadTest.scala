@@ -36,6 +36,41 @@ class BblfshClientLoadTest extends BblfshClientBaseTest {
     root.children.foreach(println)
   }
 
+  "Loading Go -> JVM repeatedly" should "share the strings of keys and frequent types" in {
+    val uast = resp.uast.decode()
+    val root1 = uast.root().load()
+    val root2 = uast.root().load()
+    // values are only interned once they were seen a few times
+    val roots = (1 to 4).map(_ => uast.root().load())
+    uast.dispose()
+
+    root1.keyAt(0) should be theSameInstanceAs (root2.keyAt(0))
+    val JString(type1) = roots(2)("@type")
+    val JString(type2) = roots(3)("@type")
+    type1 should be theSameInstanceAs (type2)
+  }
+
+  "Lazy loading Go -> JVM of a real tree" should "produce the same tree as load" in {
+    val uast = resp.uast.decode()
+    val root = uast.root().lazyLoad()
+    uast.dispose() // the lazy view does not depend on the context
+
+    root shouldBe a [JObject]
+    root.children.size shouldBe 6
+    root("imports") should be (JNull())
+
+    val expected = resp.uast.decode().root().load()
+    root should equal (expected)
+  }
+
+  "Flat loading Go -> JVM of a real tree" should "produce the same tree as load" in {
+    val uast = resp.uast.decode()
+    val root = uast.root()
+
+    root.loadFlat() should equal (root.load())
+    uast.dispose()
+  }
+
   "Loading Go -> JVM for a simple encoded tree" should "bring JNode tree to memory" in {
     val rootTree: JNode = JArray(
       JObject(
@@ -54,6 +54,44 @@ class BblfshClientUastApiTest extends BblfshClientBaseTest {
     node1 should equal(node3)
   }
 
+  "Decode from heap memory" should "match the direct buffer decoding" in {
+    val node1 = resp.uast.decode.root.load()
+    val bytes: Array[Byte] = resp.uast.toByteArray
+
+    val node2 = JNode.parseFrom(ByteBuffer.wrap(bytes))
+    node1 should equal(node2)
+
+    // an array slice, decoded in place
+    val padded = Array[Byte](1, 2, 3) ++ bytes
+    val slice = ByteBuffer.wrap(padded, 3, bytes.length).slice()
+    slice.isDirect should be(false)
+    val ctx = BblfshClient.decode(slice)
+    ctx.root.load() should equal(node1)
+    ctx.dispose()
+
+    // a ByteString backed by a part of a larger array
+    val sub = ByteString.copyFrom(padded).substring(3)
+    val node3 = sub.decode().root.load()
+    node1 should equal(node3)
+  }
+
+  "Decode from a file" should "match the direct buffer decoding" in {
+    val node1 = resp.uast.decode.root.load()
+
+    val file = java.io.File.createTempFile("uast", ".bin")
+    file.deleteOnExit()
+    java.nio.file.Files.write(file.toPath, resp.uast.toByteArray)
+
+    val ctx = BblfshClient.decodeFile(file.getPath)
+    ctx.root.load() should equal(node1)
+    ctx.dispose()
+    file.delete()
+
+    a[RuntimeException] should be thrownBy {
+      BblfshClient.decodeFile(file.getPath)
+    }
+  }
+
   "Encode JNode to the binary" should "result in bytes" in {
     val node: JNode = JArray(
       JObject(
@@ -77,6 +115,32 @@ class BblfshClientUastApiTest extends BblfshClientBaseTest {
     ByteBuffer.wrap(bytes3) should equal(bytes1)
   }
 
+  "Encode a real JNode tree" should "match the Context encoding" in {
+    val node: JNode = resp.get()
+
+    val ctx = Context()
+    val expected = ctx.encode(node)
+    ctx.dispose()
+
+    node.toByteBuffer should equal(expected)
+  }
+
+  "Encode a JNode tree with JNothing" should "match the Context encoding" in {
+    val node: JNode = JArray(
+      JObject(
+        "k1" -> JNothing,
+        "k2" -> JNull()
+      ),
+      JNothing
+    )
+
+    val ctx = Context()
+    val expected = ctx.encode(node)
+    ctx.dispose()
+
+    node.toByteBuffer should equal(expected)
+  }
+
   "XPath query" should "filter native UAST" in {
     val uast: NodeExt = resp.uast.decode().root()
     val it = BblfshClient.filter(uast, "//uast:Position")
@@ -74,6 +74,39 @@ class FilterManagedTest extends BblfshClientBaseTest {
     }
   }
 
+  "Context arena" should "account the memory of node mirrors" in {
+    val ctx = Context()
+    val it = ctx.filter("//*", managedRoot)
+    it.toList should not be empty
+
+    ctx.arenaBytes() should be > 0L
+    Context.arenaPeakBytes() should be >= ctx.arenaBytes()
+    it.close()
+  }
+
+  "Filtering a native snapshot" should "return the original nodes" in {
+    val snapshot = managedRoot.snapshot()
+
+    val expected = BblfshClient.filter(managedRoot, "//*").toList
+    val found = snapshot.filter("//*")
+    found should have size (expected.size)
+    for ((a, b) <- found.zip(expected)) {
+      a should be theSameInstanceAs (b)
+    }
+
+    snapshot.filter("count(//*)") should be (Seq(JInt(expected.size)))
+    snapshot.dispose()
+  }
+
+  "Filtering UAST values natively" should "match the typed filters" in {
+    BblfshClient.filterInts(managedRoot, "count(//*)") should have size (1)
+    BblfshClient.filterInts(managedRoot, "//*").toList should be (List(24L))
+    BblfshClient.filterBools(managedRoot, "//*").toList should be (List(true, false))
+    BblfshClient.filterStrings(managedRoot, "//*").toList should be (List("file", "v1", "v2"))
+    BblfshClient.filterFloats(managedRoot, "//*").toList should be (List(1.0, 2.0))
+    BblfshClient.filterUints(managedRoot, "//*") shouldBe empty
+  }
+
   "Filtering UAST" should "work in Annotated mode" in {
     val fileContent = Source.fromFile(fileName).getLines.mkString("\n")
     val resp = client.parse(fileName, fileContent, Mode.ANNOTATED)
@@ -42,4 +42,40 @@ class FilterNativeTest extends FlatSpec
     pos should have size (8)  // Tiny.java contains 8 nodes with position
   }
 
+  "XPath filter over handles" should "find all positions under context" in {
+    val it = nativeRootCtx.filterHandles("//uast:Position")
+    val out = new Array[Long](16)
+
+    it.nextHandles(out) should be(8) // Tiny.java contains 8 nodes with position
+    it.nextHandles(out) should be(0)
+    it.hasNext should be(false)
+  }
+
+  "XPath count and exists" should "not need an iterator" in {
+    nativeRootCtx.count("//uast:Position") should be(8) // Tiny.java contains 8 nodes with position
+    nativeRootCtx.count("//uast:NoSuchType") should be(0)
+    nativeRootCtx.exists("//uast:Position") should be(true)
+    nativeRootCtx.exists("//uast:NoSuchType") should be(false)
+  }
+
+  "XPath filter of values" should "return primitive results" in {
+    nativeRootCtx.filterInts("count(//uast:Position)").toList should be (List(8L))
+    nativeRootCtx.filterStrings("//uast:Identifier/@Name") should not be empty
+    // objects are skipped, not loaded
+    nativeRootCtx.filterInts("//uast:Position") should be (empty)
+  }
+
+  "XPath filter of many queries" should "group the matches by query" in {
+    val queries = Array("//uast:Position", "//uast:Identifier", "//uast:NoSuchType")
+    val results = nativeRootCtx.root().filterAll(queries)
+
+    results should have size (3)
+    for ((query, handles) <- queries.zip(results)) {
+      val expected = nativeRootCtx.filter(query).map(_.handle).toList
+      handles.toList should equal (expected)
+    }
+    results(0) should have size (8) // Tiny.java contains 8 nodes with position
+    results(2) shouldBe empty
+  }
+
 }
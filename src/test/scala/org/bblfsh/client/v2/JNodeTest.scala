@@ -53,6 +53,19 @@ class JNodeTest extends FlatSpec
     obj("k2") shouldBe JBool(false)
   }
 
+  "JNode" should "expose a kind tag matching the libuast kinds" in {
+    import BblfshClient._
+
+    JNull().kindTag shouldEqual NullKind.toInt
+    JObject().kindTag shouldEqual ObjectKind.toInt
+    JArray().kindTag shouldEqual ArrayKind.toInt
+    JString("s").kindTag shouldEqual StringKind.toInt
+    JInt(1).kindTag shouldEqual IntKind.toInt
+    JUint(1).kindTag shouldEqual UintKind.toInt
+    JFloat(1.0).kindTag shouldEqual FloatKind.toInt
+    JBool(true).kindTag shouldEqual BoolKind.toInt
+  }
+
   "JNode object and array" should "expose add" in {
     // object
     val obj = rootTree.children(0).asInstanceOf[JObject]
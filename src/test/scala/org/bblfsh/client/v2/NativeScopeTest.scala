@@ -0,0 +1,91 @@
+package org.bblfsh.client.v2
+
+class NativeScopeTest extends BblfshClientBaseTest {
+
+  import BblfshClient._ // enables uast.* methods
+
+  "NativeScope" should "dispose the contexts and iterators created in it" in {
+    var ctx: ContextExt = null
+    val it = NativeScope.run { scope =>
+      ctx = resp.uast.decode()
+      val it = ctx.filter("//uast:Identifier")
+      scope.size should be(2)
+      it
+    }
+
+    ctx.nativeContext should be(0)
+    it.hasNext() should be(false)
+    a[RuntimeException] should be thrownBy {
+      ctx.root()
+    }
+  }
+
+  "NativeScope" should "make the nodes of its contexts throw on load" in {
+    val node = NativeScope.run { _ => resp.uast.decode().root() }
+
+    the[RuntimeException] thrownBy {
+      node.load()
+    } should have message "ContextExt was already disposed"
+    a[RuntimeException] should be thrownBy {
+      node.loadBuffer()
+    }
+  }
+
+  "NativeScope" should "dispose managed iterators before their context" in {
+    val root = resp.uast.decode().root().load()
+    val expected = BblfshClient.iterator(root, PreOrder).size
+
+    val it = NativeScope.run { scope =>
+      val it = BblfshClient.iterator(root, PreOrder)
+      scope.size should be(1)
+      it.next() should not be (null)
+      it
+    }
+    it.hasNext() should be(false)
+
+    NativeScope.run { _ =>
+      BblfshClient.iterator(root, PreOrder).size should be(expected)
+    }
+  }
+
+  "NativeScope" should "leave the objects of an outer scope alone" in {
+    val outer = NativeScope()
+    val ctx = resp.uast.decode()
+    NativeScope.run { _ =>
+      resp.uast.decode().root()
+    }
+    NativeScope.active should be(Some(outer))
+    ctx.root().load() should not be (null)
+
+    outer.close()
+    outer.isClosed should be(true)
+    NativeScope.active should be(None)
+    ctx.nativeContext should be(0)
+  }
+
+  "NativeScope" should "fall back to the open ancestor when closed out of order" in {
+    val outer = NativeScope()
+    val middle = NativeScope()
+    val inner = NativeScope()
+
+    middle.close()
+    inner.close()
+    NativeScope.active should be(Some(outer))
+    val ctx = resp.uast.decode()
+    outer.size should be(1)
+
+    outer.close()
+    NativeScope.active should be(None)
+    ctx.nativeContext should be(0)
+  }
+
+  "NativeScope" should "keep the encoded buffers readable after close" in {
+    val ctx = resp.uast.decode()
+    val expected = ctx.root().load()
+
+    val buf = NativeScope.run { _ => ctx.encode(ctx.root()) }
+    BblfshClient.decode(buf).root().load() should equal(expected)
+    ctx.dispose()
+  }
+
+}
@@ -0,0 +1,44 @@
+package org.bblfsh.client.v2
+
+// The counters are shared by all the suites, that may run in parallel,
+// so only bounds that hold regardless of other tests are checked.
+class NativeStatsTest extends BblfshClientBaseTest {
+
+  import BblfshClient._ // enables uast.* methods
+
+  "NativeStats" should "count the live contexts and iterators" in {
+    val ctx = resp.uast.decode()
+    val it = ctx.filter("//uast:Identifier")
+
+    val stats = NativeStats()
+    stats.contextsExt should be >= 1L
+    stats.iterators should be >= 1L
+    stats.decodedBytes should be >= resp.uast.size.toLong
+
+    it.close()
+    ctx.dispose()
+  }
+
+  "NativeStats" should "count the node mirrors and their references" in {
+    val tree = resp.uast.decode().root().load()
+    val before = NativeStats()
+
+    val ctx = Context()
+    ctx.filter("//uast:Identifier", tree).toList
+    val stats = NativeStats()
+    stats.contexts should be >= 1L
+    stats.nodes should be >= 1L
+    stats.globalRefsCreated should be > before.globalRefsCreated
+
+    ctx.dispose()
+  }
+
+  "NativeStats" should "not hold the encoded buffers after encode" in {
+    val ctx = resp.uast.decode()
+    val buf = ctx.encode(ctx.root())
+    buf.hasArray should be(true)
+    NativeStats().encodedBytes should be >= 0L
+    ctx.dispose()
+  }
+
+}
@@ -0,0 +1,81 @@
+package org.bblfsh.client.v2
+
+import org.scalatest.{BeforeAndAfter, FlatSpec, Matchers}
+
+import scala.io.Source
+
+class TreeCursorTest extends FlatSpec
+  with Matchers
+  with BeforeAndAfter {
+
+  import BblfshClient._ // enables uast.* methods
+
+  var ctx: ContextExt = _
+  var cursor: TreeCursor = _
+
+  before {
+    val client = BblfshClient("localhost", 9432)
+    val file = "src/test/resources/Tiny.java"
+    val resp = client.parse(file, Source.fromFile(file).getLines.mkString("\n"))
+    client.close()
+    ctx = resp.uast.decode()
+    cursor = ctx.root().cursor()
+  }
+
+  after {
+    cursor.dispose()
+    ctx.dispose()
+  }
+
+  "TreeCursor" should "expose the root as an object with a type" in {
+    val root = cursor.root()
+    cursor.kind(root) should be(ObjectKind.toInt)
+
+    val typ = cursor.get(root, "@type")
+    cursor.kind(typ) should be(StringKind.toInt)
+    cursor.asString(typ) should be("uast:File")
+
+    cursor.get(root, "no-such-key") should be(0)
+  }
+
+  "TreeCursor" should "match the loaded JNode tree" in {
+    val expected = ctx.root().load()
+
+    def check(node: Long, jnode: JNode): Unit = {
+      cursor.size(node) should be(jnode.size)
+      jnode match {
+        case JObject(_) =>
+          for (i <- 0 until jnode.size) {
+            cursor.keyAt(node, i) should be(jnode.keyAt(i))
+            check(cursor.valueAt(node, i), jnode.valueAt(i))
+          }
+        case JArray(_) =>
+          for (i <- 0 until jnode.size) {
+            check(cursor.valueAt(node, i), jnode.valueAt(i))
+          }
+        case JString(str) => cursor.asString(node) should be(str)
+        case JInt(num) => cursor.asInt(node) should be(num)
+        case JUint(num) => cursor.asUint(node) should be(num)
+        case JFloat(num) => cursor.asFloat(node) should be(num)
+        case JBool(v) => cursor.asBool(node) should be(v)
+        case JNull() => cursor.kind(node) should be(NullKind.toInt)
+      }
+    }
+
+    check(cursor.root(), expected)
+  }
+
+  "TreeCursor" should "look up keys without native allocations" in {
+    val lib = new libuast.Libuast
+    assume(lib.allocations() >= 0, "requires ./build.sh --compile-test")
+
+    val root = cursor.root()
+    val typ = cursor.get(root, "@type") // warms up the scratch buffer
+    val before = lib.allocations()
+    for (_ <- 1 to 1000) {
+      cursor.get(root, "@type") should be(typ)
+    }
+    lib.allocations() should be(before)
+  }
+
+}
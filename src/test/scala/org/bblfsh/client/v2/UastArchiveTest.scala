@@ -0,0 +1,74 @@
+package org.bblfsh.client.v2
+
+import java.io.File
+
+class UastArchiveTest extends BblfshClientBaseTest {
+
+  import BblfshClient._ // enables uast.* methods
+
+  override val fileName = "src/test/resources/Tiny.java"
+
+  def tempArchive(): File = {
+    val file = File.createTempFile("uast", ".uar")
+    file.deleteOnExit()
+    file
+  }
+
+  "UastArchive" should "decode each entry by its key" in {
+    val expected = resp.uast.decode().root().load()
+    val file = tempArchive()
+
+    val w = UastArchive.create(file.getPath)
+    w.add("Tiny.java", resp.uast, "java".getBytes)
+    w.add("Empty.java", resp.uast)
+    w.close()
+
+    val archive = UastArchive(file.getPath)
+    archive.size() should be(2)
+    archive.keys() should be(Seq("Tiny.java", "Empty.java"))
+    archive.contains("Tiny.java") should be(true)
+    archive.contains("Other.java") should be(false)
+    new String(archive.metadata("Tiny.java").get) should be("java")
+    archive.metadata("Empty.java").get should be(empty)
+    archive.metadata("Other.java") should be(None)
+
+    val ctx = archive.decode("Tiny.java")
+    archive.dispose()
+    // the context keeps the archive mapped
+    ctx.root().load() should equal(expected)
+    ctx.dispose()
+  }
+
+  "UastArchive" should "keep the existing entries on append" in {
+    val file = tempArchive()
+    val bytes = resp.uast.toByteArray
+
+    val w1 = UastArchive.create(file.getPath)
+    w1.add("Tiny.java", bytes)
+    w1.close()
+
+    val w2 = UastArchive.append(file.getPath)
+    w2.size should be(1)
+    val key = w2.addByHash(bytes)
+    w2.close()
+    key should be(UastArchive.contentKey(bytes))
+
+    val archive = UastArchive(file.getPath)
+    archive.keys() should be(Seq("Tiny.java", key))
+    archive.decode(key).root().load() should equal(archive.decode("Tiny.java").root().load())
+    a[RuntimeException] should be thrownBy {
+      archive.decode("Other.java")
+    }
+    archive.dispose()
+  }
+
+  "UastArchive" should "reject files that are not archives" in {
+    val file = tempArchive()
+    java.nio.file.Files.write(file.toPath, resp.uast.toByteArray)
+
+    a[RuntimeException] should be thrownBy {
+      UastArchive(file.getPath)
+    }
+  }
+
+}
@@ -0,0 +1,68 @@
+package org.bblfsh.client.v2.bench
+
+import java.nio.ByteBuffer
+
+import org.bblfsh.client.v2.{BatchFilter, BblfshClient}
+import org.scalatest.{BeforeAndAfterAll, FlatSpec, Matchers}
+
+import scala.io.Source
+
+class BatchFilterScalingBenchmark extends FlatSpec
+  with Matchers
+  with BeforeAndAfterAll {
+
+  import BblfshClient._ // enables uast.* methods
+
+  val client = BblfshClient("localhost", 9432)
+  val files = Seq(
+    "src/test/resources/SampleJavaFile.java",
+    "src/test/resources/Tiny.java",
+    "src/test/resources/large.php",
+    "src/test/resources/python_file.py"
+  )
+  val queries = Seq("//uast:Identifier", "//uast:String", "//*[@role='Function']")
+  val corpusSize: Int = Integer.getInteger("bblfsh.bench.corpus", 256)
+
+  /** Synthetic corpus: the encoded UASTs of the test resources, repeated */
+  lazy val corpus: Seq[ByteBuffer] = {
+    val uasts = files.map { file =>
+      val resp = client.parse(file, Source.fromFile(file).getLines.mkString("\n"))
+      val buf = ByteBuffer.allocateDirect(resp.uast.size)
+      resp.uast.copyTo(buf)
+      buf.flip()
+      buf
+    }
+    (0 until corpusSize).map(i => uasts(i % uasts.size))
+  }
+
+  override def afterAll {
+    client.close()
+  }
+
+  "BatchFilter" should "return the same counts as ContextExt.count" in {
+    val counts = BatchFilter.count(corpus.take(files.size), queries)
+    counts.buffers should be(files.size)
+
+    for ((buf, i) <- corpus.take(files.size).zipWithIndex) {
+      val ctx = BblfshClient.decode(buf)
+      counts.failed(i) should be(false)
+      counts.of(i) should be(queries.map(ctx.count).toArray)
+      ctx.dispose()
+    }
+  }
+
+  "BatchFilter" should "scale with the number of threads" in {
+    val cores = Runtime.getRuntime.availableProcessors
+    val threads = Iterator.iterate(1)(_ * 2).takeWhile(_ < cores).toSeq :+ cores
+
+    val nsPerOp = threads.map { n =>
+      Benchmark.measure(s"BatchFilter $corpusSize buffers, $n threads") {
+        BatchFilter.count(corpus, queries, n)
+      }
+    }
+    for ((n, ns) <- threads.zip(nsPerOp)) {
+      println(f"[bench] BatchFilter $n%3d threads: ${nsPerOp.head / ns}%.2fx speedup")
+    }
+  }
+
+}
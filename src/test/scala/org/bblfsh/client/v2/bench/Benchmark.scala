@@ -0,0 +1,22 @@
+package org.bblfsh.client.v2.bench
+
+/**
+  * Minimal timing helpers for the benchmarks under this package.
+  *
+  * Benchmarks run as regular tests with a small number of iterations,
+  * use -Dbblfsh.bench.iterations=N to get stable numbers.
+  */
+object Benchmark {
+  val iterations: Int = Integer.getInteger("bblfsh.bench.iterations", 10)
+  val warmup: Int = Integer.getInteger("bblfsh.bench.warmup", 3)
+
+  /** Runs f warmup + iterations times, prints and returns the mean ns/op */
+  def measure[T](name: String, times: Int = iterations)(f: => T): Double = {
+    for (_ <- 1 to warmup) f
+    val start = System.nanoTime()
+    for (_ <- 1 to times) f
+    val nsPerOp = (System.nanoTime() - start).toDouble / times
+    println(f"[bench] $name%-50s ${nsPerOp / 1e6}%10.3f ms/op")
+    nsPerOp
+  }
+}
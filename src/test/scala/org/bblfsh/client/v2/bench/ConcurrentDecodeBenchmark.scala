@@ -0,0 +1,36 @@
+package org.bblfsh.client.v2.bench
+
+import org.bblfsh.client.v2.{BblfshClient, BblfshClientBaseTest}
+import org.bblfsh.client.v2.BblfshClientConcurrencyTest.runConcurrently
+
+class ConcurrentDecodeBenchmark extends BblfshClientBaseTest {
+
+  import BblfshClient._ // enables uast.* methods
+
+  override val fileName = "src/test/resources/large.php"
+
+  val query = "//uast:Identifier"
+  val tasks = 16
+
+  /** Decodes and filters the parsed UAST, returns the number of matches */
+  def decodeAndFilter(): Int = {
+    val ctx = resp.uast.decode()
+    val it = BblfshClient.filter(ctx.root(), query)
+    val matches = it.size
+    it.close()
+    ctx.dispose()
+    matches
+  }
+
+  "Decode and filter of large.php" should "be measured from 1 and N threads" in {
+    val threads = Runtime.getRuntime.availableProcessors.max(2)
+    for (n <- Seq(1, threads)) {
+      var results = Seq[Int]()
+      Benchmark.measure(s"decode+filter x$tasks on $n threads") {
+        results = runConcurrently(n, tasks)(decodeAndFilter())
+      }
+      results should have size tasks
+    }
+  }
+
+}
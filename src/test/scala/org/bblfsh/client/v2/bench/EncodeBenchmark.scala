@@ -0,0 +1,25 @@
+package org.bblfsh.client.v2.bench
+
+import org.bblfsh.client.v2.{BblfshClient, BblfshClientBaseTest, Context, JNode}
+
+class EncodeBenchmark extends BblfshClientBaseTest {
+
+  import BblfshClient._ // enables uast.* methods
+
+  override val fileName = "src/test/resources/large.php"
+
+  "Encoding a managed large.php tree" should "be measured" in {
+    val root: JNode = resp.get()
+
+    Benchmark.measure("Context.encode large.php") {
+      val ctx = Context()
+      ctx.encode(root)
+      ctx.dispose()
+    }
+
+    Benchmark.measure("JNode.toByteArray large.php") {
+      root.toByteArray
+    }
+  }
+
+}
@@ -0,0 +1,29 @@
+package org.bblfsh.client.v2.bench
+
+import org.bblfsh.client.v2.{BblfshClient, BblfshClientBaseTest, ContextExt}
+import org.bblfsh.client.v2.BblfshClient.{PositionOrder, PreOrder}
+
+class IteratorBatchBenchmark extends BblfshClientBaseTest {
+
+  import BblfshClient._ // enables uast.* methods
+
+  override val fileName = "src/test/resources/large.php"
+
+  "UastIterExt over large.php" should "be measured for different batch sizes" in {
+    val ctx: ContextExt = resp.uast.decode()
+    val root = ctx.root()
+
+    for (order <- Seq(PreOrder, PositionOrder); batchSize <- Seq(1, 64, 1024)) {
+      var nodes = 0
+      Benchmark.measure(s"UastIterExt $order batch=$batchSize") {
+        val it = BblfshClient.iterator(root, order, batchSize)
+        nodes = it.size
+        it.close()
+      }
+      nodes should be > 0
+    }
+
+    ctx.dispose()
+  }
+
+}
@@ -0,0 +1,26 @@
+package org.bblfsh.client.v2.bench
+
+import org.bblfsh.client.v2.{BblfshClientBaseTest, ContextExt}
+
+class NodeExtLoadBenchmark extends BblfshClientBaseTest {
+
+  import org.bblfsh.client.v2.BblfshClient._ // enables uast.* methods
+
+  override val fileName = "src/test/resources/large.php"
+
+  "NodeExt.load() of large.php" should "be measured" in {
+    val ctx: ContextExt = resp.uast.decode()
+    val root = ctx.root()
+
+    root.load().size should be > 0
+    Benchmark.measure("NodeExt.load large.php") {
+      root.load()
+    }
+    Benchmark.measure("NodeExt.loadFlat large.php") {
+      root.loadFlat()
+    }
+
+    ctx.dispose()
+  }
+
+}
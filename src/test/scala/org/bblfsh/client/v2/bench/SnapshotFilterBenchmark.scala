@@ -0,0 +1,36 @@
+package org.bblfsh.client.v2.bench
+
+import org.bblfsh.client.v2.{BblfshClient, BblfshClientBaseTest, JNode}
+
+class SnapshotFilterBenchmark extends BblfshClientBaseTest {
+
+  import BblfshClient._ // enables uast.* methods
+
+  override val fileName = "src/test/resources/large.php"
+
+  val query = "//uast:Identifier"
+
+  "Filtering a managed large.php tree" should "be measured" in {
+    val root: JNode = resp.get()
+
+    var expected = 0
+    Benchmark.measure("Context.filter large.php") {
+      val it = BblfshClient.filter(root, query)
+      expected = it.size
+      it.close()
+    }
+
+    Benchmark.measure("JNodeSnapshot.filter large.php, with snapshot") {
+      val snapshot = root.snapshot()
+      snapshot.filter(query).size should be (expected)
+      snapshot.dispose()
+    }
+
+    val snapshot = root.snapshot()
+    Benchmark.measure("JNodeSnapshot.filter large.php, query only") {
+      snapshot.filter(query).size
+    }
+    snapshot.dispose()
+  }
+
+}
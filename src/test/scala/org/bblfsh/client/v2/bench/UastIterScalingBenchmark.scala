@@ -0,0 +1,42 @@
+package org.bblfsh.client.v2.bench
+
+import org.bblfsh.client.v2._
+import org.bblfsh.client.v2.BblfshClient.PreOrder
+import org.scalatest.{FlatSpec, Matchers}
+
+class UastIterScalingBenchmark extends FlatSpec with Matchers {
+
+  /** Builds a tree of nested objects with the given number of leaves */
+  def tree(leaves: Int): JNode = {
+    val arr = new JArray(leaves)
+    for (i <- 0 until leaves) {
+      arr.add(JObject(
+        "@type" -> JString("uast:Identifier"),
+        "Name" -> JString(s"id$i"),
+        "pos" -> JObject("line" -> JInt(i), "col" -> JInt(1))
+      ))
+    }
+    JObject("@type" -> JString("uast:File"), "body" -> arr)
+  }
+
+  "UastIter over a managed JNode tree" should "scale linearly with the number of nodes" in {
+    val sizes = Seq(1000, 4000, 16000)
+    val nsPerNode = for (n <- sizes) yield {
+      val root = tree(n)
+      var nodes = 0
+      val ns = Benchmark.measure(s"UastIter PreOrder $n leaves") {
+        val it = BblfshClient.iterator(root, PreOrder)
+        nodes = it.size
+        it.close()
+      }
+      nodes should be > n
+      val perNode = ns / nodes
+      println(f"[bench] UastIter PreOrder $n%d leaves: $perNode%.1f ns/node")
+      perNode
+    }
+
+    // structural hashing made this quadratic: per-node cost grew with the tree
+    nsPerNode.last should be < (nsPerNode.head * 4)
+  }
+
+}
@@ -181,6 +181,16 @@ class IteratorManagedTest extends FlatSpec
     posIter.close()
   }
 
+  "Managed UAST iterator" should "return the same nodes for any batch size" in {
+    val expected = getNodeTypes(BblfshClient.iterator(testTree, PreOrder, 1))
+    expected should have size (7)
+
+    for (batchSize <- Seq(2, 3, 1024)) {
+      iter = BblfshClient.iterator(testTree, PreOrder, batchSize)
+      getNodeTypes(iter) shouldEqual expected
+    }
+  }
+
   "Managed UAST iterator with invalid numeric order" should "use AnyOrder" in {
     val invalidNumIter = BblfshClient.iterator(testTree, -1)
     val anyOrderIter = BblfshClient.iterator(testTree, AnyOrder)
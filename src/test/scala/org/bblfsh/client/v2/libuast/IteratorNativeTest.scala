@@ -79,4 +79,29 @@ class IteratorNativeTest extends FlatSpec
     nodes.size should be equals (totalJnodes)
   }
 
+  "Native UAST iterator" should "return the same nodes for any batch size" in {
+    val expected = iter.toList.map(_.handle)
+    expected shouldNot be(empty)
+
+    for (batchSize <- Seq(1, 3, 1024)) {
+      val it = BblfshClient.iterator(nativeRootNode, BblfshClient.PreOrder, batchSize)
+      it.toList.map(_.handle) shouldEqual expected
+      it.close()
+    }
+  }
+
+  "Native UAST handle iterator" should "return the handles of the same nodes" in {
+    val expected = iter.toList.map(_.handle)
+
+    val it = BblfshClient.handleIterator(nativeRootNode, BblfshClient.PreOrder)
+    val handles = scala.collection.mutable.ArrayBuffer[Long]()
+    it.foreach(handles += _)
+
+    handles shouldEqual expected
+    it.hasNext should be(false)
+
+    val node = nativeRootNode.ctx.node(handles.head)
+    node shouldEqual nativeRootNode
+  }
+
 }